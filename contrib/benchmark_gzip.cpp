@@ -0,0 +1,119 @@
+/*
+Benchmark gzip compression
+==========================
+
+Size, write time and read time of samples written uncompressed and at
+several gzip levels, as streamed JSON and as a PolyChord text file that is
+compressed after the run and read back transparently.
+
+make benchmarks
+*/
+
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "polystan/gzip.hpp"
+#include "polystan/json.hpp"
+#include "polystan/read.hpp"
+#include "polystan/rng.hpp"
+#include "polystan/timing.hpp"
+
+namespace ps = polystan;
+
+const int NCOLS = 20;
+const int NROWS = 500000;
+const char JSON_FILE_NAME[] = "benchmark_gzip.json";
+const char TXT_FILE_NAME[] = "benchmark_gzip.txt";
+const std::vector<int> LEVELS{0, 1, 6, 9};
+
+std::vector<std::vector<double>> make_columns() {
+  const ps::rng::Stream stream(0);
+  std::vector<std::vector<double>> columns(NCOLS,
+                                           std::vector<double>(NROWS));
+  for (int i = 0; i < NCOLS; i++) {
+    for (int j = 0; j < NROWS; j++) {
+      columns[i][j] = stream.uniform(i * NROWS + j);
+    }
+  }
+  return columns;
+}
+
+void report(const std::string& name, const std::string& file_name,
+            double write_time, double read_time) {
+  const double size = std::filesystem::file_size(file_name) / 1e6;
+  std::cout << name << ": " << size << " MB, written in " << write_time
+            << " s";
+  if (read_time >= 0.) {
+    std::cout << ", read in " << read_time << " s";
+  }
+  std::cout << "\n";
+  std::filesystem::remove(file_name);
+}
+
+void json(const std::vector<std::vector<double>>& columns, int level) {
+  const std::string file_name
+      = std::string(JSON_FILE_NAME) + (level > 0 ? ps::gzip::SUFFIX : "");
+  const ps::timing::Timer timer;
+  {
+    ps::json::Stream stream(file_name, {true, 0}, level);
+    stream.start_object();
+    for (int i = 0; i < NCOLS; i++) {
+      stream.key(std::to_string(i));
+      stream.start_array();
+      stream.values(columns[i]);
+      stream.end_array();
+    }
+    stream.end_object();
+  }
+  report("JSON, gzip level " + std::to_string(level), file_name,
+         timer.elapsed(), -1.);
+}
+
+void txt(const std::vector<std::vector<double>>& columns, int level) {
+  // written in PolyChord's format and then compressed as after a run
+
+  {
+    std::FILE* file = std::fopen(TXT_FILE_NAME, "w");
+    for (int j = 0; j < NROWS; j++) {
+      for (int i = 0; i < NCOLS; i++) {
+        std::fprintf(file, " % .15E", columns[i][j]);
+      }
+      std::fprintf(file, "\n");
+    }
+    std::fclose(file);
+  }
+
+  const ps::timing::Timer write_timer;
+  if (level > 0) {
+    ps::gzip::compress_file(TXT_FILE_NAME, level);
+  }
+  const double write_time = write_timer.elapsed();
+
+  const ps::timing::Timer read_timer;
+  ps::read::Samples samples(TXT_FILE_NAME, 0, 1, 0);
+  for (int i = 0; i + 1 < NCOLS; i++) {
+    samples.take(i);
+  }
+  const double read_time = read_timer.elapsed();
+
+  const std::string file_name
+      = std::string(TXT_FILE_NAME) + (level > 0 ? ps::gzip::SUFFIX : "");
+  report("text, gzip level " + std::to_string(level), file_name, write_time,
+         read_time);
+}
+
+int main() {
+  const auto columns = make_columns();
+  std::cout << NCOLS << " columns of " << NROWS << " samples\n";
+
+  for (const int level : LEVELS) {
+    json(columns, level);
+  }
+
+  for (const int level : LEVELS) {
+    txt(columns, level);
+  }
+}
@@ -0,0 +1,92 @@
+/*
+Benchmark insertion indexes
+===========================
+
+Time to compute insertion indexes of a simulated run by sweeping with a
+Fenwick tree and by the original double loop. The double loop is timed on a
+subset of points and extrapolated, as it is O(n^2).
+
+make benchmarks
+*/
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "polystan/rng.hpp"
+#include "polystan/test.hpp"
+#include "polystan/timing.hpp"
+
+namespace ps = polystan;
+
+const int NLIVE = 500;
+const int NSUBSET = 1000;
+
+std::array<std::vector<double>, 2> simulate(int n) {
+  // live points replaced by draws from the constrained prior. with loglike
+  // -log X, a replacement is an exponential variate above the contour
+
+  const ps::rng::Stream stream(0);
+  std::uint64_t counter = 0;
+  auto exponential = [&]() { return -std::log1p(-stream.uniform(counter++)); };
+
+  typedef std::pair<double, double> Point;  // loglike, birth
+  std::priority_queue<Point, std::vector<Point>, std::greater<Point>> live;
+
+  for (int i = 0; i < NLIVE; i++) {
+    live.emplace(exponential(), -1e30);
+  }
+
+  std::array<std::vector<double>, 2> death_birth;
+
+  while (death_birth[0].size() < n) {
+    const auto [death, birth] = live.top();
+    live.pop();
+    death_birth[0].push_back(death);
+    death_birth[1].push_back(birth);
+
+    if (death_birth[0].size() + live.size() < n) {
+      live.emplace(death + exponential(), death);
+    }
+  }
+
+  return death_birth;
+}
+
+int main() {
+  for (const int n : {10000, 1000000, 10000000}) {
+    auto [death, birth] = simulate(n);
+    ps::test::sort_by_birth(death, birth);
+
+    ps::timing::Timer timer;
+    const auto indexes = ps::test::insertion_indexes(death, birth);
+    const double sweep = timer.elapsed();
+
+    const int subset = std::min(n, NSUBSET);
+    ps::timing::Timer brute_timer;
+    const auto brute
+        = ps::test::insertion_indexes_brute_force(death, birth, 0, subset);
+    const double brute_force = brute_timer.elapsed() * n / subset;
+
+    const bool agree
+        = std::equal(brute.begin(), brute.end(), indexes.begin());
+
+    timer = ps::timing::Timer();
+    const double p_value
+        = ps::test::insertion_index_p_value(death, birth, NLIVE, 1);
+    const double batches = timer.elapsed();
+
+    std::cout << "n = " << n << "\n"
+              << "  sweep / s = " << sweep << "\n"
+              << "  double loop / s = " << brute_force
+              << (subset < n ? " (extrapolated)" : "") << "\n"
+              << "  agree = " << std::boolalpha << agree << "\n"
+              << "  batched p-value = " << p_value << " in " << batches
+              << " s\n";
+  }
+}
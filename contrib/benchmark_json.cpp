@@ -0,0 +1,81 @@
+/*
+Benchmark JSON output
+=====================
+
+Size and write time of samples written to JSON as a DOM, as we did
+originally, and streamed in pretty, compact and reduced precision formats.
+
+make benchmarks
+*/
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "polystan/json.hpp"
+#include "polystan/rng.hpp"
+#include "polystan/timing.hpp"
+
+namespace ps = polystan;
+
+const int NCOLS = 100;
+const int NROWS = 100000;
+const char FILE_NAME[] = "benchmark_json.json";
+
+std::vector<std::vector<double>> make_columns() {
+  const ps::rng::Stream stream(0);
+  std::vector<std::vector<double>> columns(NCOLS,
+                                           std::vector<double>(NROWS));
+  for (int i = 0; i < NCOLS; i++) {
+    for (int j = 0; j < NROWS; j++) {
+      columns[i][j] = stream.uniform(i * NROWS + j);
+    }
+  }
+  return columns;
+}
+
+void report(const std::string& name, double time) {
+  const double size = std::filesystem::file_size(FILE_NAME) / 1e6;
+  std::cout << name << ": " << size << " MB in " << time << " s\n";
+  std::filesystem::remove(FILE_NAME);
+}
+
+void dom(const std::vector<std::vector<double>>& columns) {
+  const ps::timing::Timer timer;
+  ps::json::Object document;
+  for (int i = 0; i < NCOLS; i++) {
+    document.add(std::to_string(i), columns[i]);
+  }
+  document.write(FILE_NAME);
+  ps::json::get_allocator().Clear();
+  report("DOM, pretty", timer.elapsed());
+}
+
+void stream(const std::vector<std::vector<double>>& columns,
+            const std::string& name, const ps::json::Format& format) {
+  const ps::timing::Timer timer;
+  {
+    ps::json::Stream stream(FILE_NAME, format);
+    stream.start_object();
+    for (int i = 0; i < NCOLS; i++) {
+      stream.key(std::to_string(i));
+      stream.start_array();
+      stream.values(columns[i]);
+      stream.end_array();
+    }
+    stream.end_object();
+  }
+  report(name, timer.elapsed());
+}
+
+int main() {
+  const auto columns = make_columns();
+  std::cout << NCOLS << " columns of " << NROWS << " samples\n";
+
+  dom(columns);
+  stream(columns, "stream, pretty", {false, 0});
+  stream(columns, "stream, compact", {true, 0});
+  stream(columns, "stream, compact, 8 digits", {true, 8});
+  stream(columns, "stream, compact, 4 digits", {true, 4});
+}
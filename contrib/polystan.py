@@ -3,10 +3,15 @@ Python wrapper to build & run polystan program
 ==============================================
 """
 
+import gzip
+import io
+import json
 import os
 import subprocess
+import zipfile
 
 import arviz as az
+import numpy as np
 
 CWD = os.path.dirname(os.path.realpath(__file__))
 ROOT = os.path.normpath(os.path.join(CWD, ".."))
@@ -47,7 +52,7 @@ def run_polystan(stan_file, data_file=None, seed=0, **kwargs):
     }
 
     for k, v in kwargs.items():
-        args[k].update(v)
+        args.setdefault(k, {}).update(v)
 
     if data_file is None:
         data_file = find_data_file(target)
@@ -57,6 +62,120 @@ def run_polystan(stan_file, data_file=None, seed=0, **kwargs):
 
     subprocess.check_call(f"{target} {cli_args(**args)}", shell=True)
 
+    npy_dir = args.get("output", {}).get("npy-dir")
+    if npy_dir is not None:
+        return from_npy(npy_dir)
+
     name = os.path.split(target)[1]
     result_name = f"{name}.json"
-    return az.from_json(result_name)
+    if int(args.get("output", {}).get("compress", 0)) > 0:
+        result_name += ".gz"
+    archive = args.get("output", {}).get("archive")
+    if archive is not None:
+        result_name = f"{archive}/{result_name}"
+    return from_json(result_name)
+
+
+def split_archive(path):
+    """
+    @returns archive and member of e.g. run.zip/x.txt, or None and path
+    """
+    parts = path.split("/")
+    for i in range(1, len(parts)):
+        archive = "/".join(parts[:i])
+        if archive.endswith(".zip") and os.path.isfile(archive):
+            return archive, "/".join(parts[i:])
+    return None, path
+
+
+def open_output(path):
+    """
+    @returns text file of PolyStan or PolyChord output, which may be gzip
+    compressed and a member of an archive, e.g., run.zip/model.json
+    """
+    archive, member = split_archive(path)
+
+    if archive is None:
+        opener = gzip.open if path.endswith(".gz") else open
+        if not os.path.exists(path) and os.path.exists(path + ".gz"):
+            return gzip.open(path + ".gz", "rt")
+        return opener(path, "rt")
+
+    with zipfile.ZipFile(archive) as zf:
+        names = zf.namelist()
+        if member not in names and member + ".gz" in names:
+            member += ".gz"
+        data = zf.read(member)
+
+    if member.endswith(".gz"):
+        data = gzip.decompress(data)
+    return io.StringIO(data.decode())
+
+
+def load_txt(path):
+    """
+    @returns array of a PolyChord text file, e.g., run.zip/model_dead.txt
+    """
+    with open_output(path) as f:
+        return np.loadtxt(f, ndmin=2)
+
+
+def expand(data):
+    """
+    @returns InferenceData with deduplicated posterior samples repeated by
+    their multiplicities
+
+    Draws are selected by index, so samples that are read lazily, e.g., from
+    a Zarr store, remain so.
+    """
+    posterior = data.posterior
+    if "multiplicity" not in posterior:
+        return data
+
+    multiplicity = posterior["multiplicity"].values[0].astype(int)
+    draws = np.repeat(np.arange(multiplicity.size), multiplicity)
+    posterior = posterior.drop_vars("multiplicity").isel(draw=draws)
+    posterior = posterior.assign_coords(draw=np.arange(draws.size))
+
+    expanded = data.copy()
+    expanded.posterior = posterior
+    return expanded
+
+
+def from_json(json_file, expand_samples=True):
+    """
+    @returns InferenceData from JSON file, which may be gzip compressed and
+    a member of an archive, e.g., run.zip/model.json
+
+    The summary, quantiles and histograms groups, if present, are not
+    InferenceData groups and are dropped; read them with json.load instead.
+    Deduplicated posterior samples are expanded unless expand_samples is
+    False, in which case their multiplicities are a posterior variable.
+    """
+    with open_output(json_file) as f:
+        data = json.load(f)
+
+    for group in ["summary", "quantiles", "histograms"]:
+        data.pop(group, None)
+    data = az.from_dict(**data)
+    return expand(data) if expand_samples else data
+
+
+def from_npy(npy_dir, expand_samples=True):
+    """
+    @returns InferenceData from .npy bundle; samples are memory mapped
+    """
+    with open(os.path.join(npy_dir, "manifest.json")) as f:
+        manifest = json.load(f)
+
+    for group in ["posterior", "prior"]:
+        files = manifest[group]
+        if "metadata" in files:
+            continue
+        manifest[group] = {
+            k: np.load(os.path.join(npy_dir, v), mmap_mode="r")
+            for k, v in files.items()
+        }
+
+    data = az.from_dict(**manifest)
+    return expand(data) if expand_samples else data
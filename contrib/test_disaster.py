@@ -33,6 +33,13 @@ def test_disaster_fig():
 
     # fetch data
     shift = data["posterior"]["save_s"].to_numpy().astype(int).flatten()
+
+    # save_s is a function of x alone and draws nothing from the generated
+    # quantities generator, so this figure doesn't depend on its stream
+    x = data["posterior"]["x"].isel(x_dim_0=2).to_numpy().flatten()
+    T = 111
+    assert np.array_equal(shift, np.searchsorted(np.arange(1, T) * 1. / T, x, side="right") + 1)
+
     shift += 1851
 
     # histogram data
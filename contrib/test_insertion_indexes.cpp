@@ -0,0 +1,151 @@
+/*
+Test insertion indexes
+======================
+
+Insertion indexes found by sweeping with a Fenwick tree, and online as points
+die, must agree with the original double loop. Runs are simulated with
+births in and out of order, with tied contours, and over sub-ranges of
+points. Exits with non-zero status on any mismatch.
+
+make test-cxx
+*/
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "polystan/rng.hpp"
+#include "polystan/test.hpp"
+
+namespace ps = polystan;
+
+int failures = 0;
+
+void check(bool ok, const std::string& name) {
+  if (!ok) {
+    std::cerr << "FAILED: " << name << "\n";
+    failures++;
+  }
+}
+
+std::array<std::vector<double>, 2> simulate(int n, int nlive,
+                                            std::uint64_t seed, double tie) {
+  // live points replaced by draws from the constrained prior. with loglike
+  // -log X, a replacement is an exponential variate above the contour. if
+  // tie > 0, loglikes are rounded down to multiples of it, so that deaths
+  // and births tie
+
+  const ps::rng::Stream stream(seed);
+  std::uint64_t counter = 0;
+  auto draw = [&](double contour) {
+    const double x = contour - std::log1p(-stream.uniform(counter++));
+    return tie > 0. ? std::max(contour, std::floor(x / tie) * tie) : x;
+  };
+
+  typedef std::pair<double, double> Point;  // loglike, birth
+  std::priority_queue<Point, std::vector<Point>, std::greater<Point>> live;
+
+  for (int i = 0; i < nlive; i++) {
+    live.emplace(draw(0.), -1e30);
+  }
+
+  std::array<std::vector<double>, 2> death_birth;
+
+  while (death_birth[0].size() < n) {
+    const auto [death, birth] = live.top();
+    live.pop();
+    death_birth[0].push_back(death);
+    death_birth[1].push_back(birth);
+
+    if (death_birth[0].size() + live.size() < n) {
+      live.emplace(draw(death), death);
+    }
+  }
+
+  return death_birth;
+}
+
+void permute(std::vector<double>& death, std::vector<double>& birth,
+             std::uint64_t seed) {
+  const ps::rng::Stream stream(seed);
+  for (int i = death.size() - 1; i > 0; i--) {
+    const int j = stream.uniform(i) * (i + 1);
+    std::swap(death[i], death[j]);
+    std::swap(birth[i], birth[j]);
+  }
+}
+
+void test_sweep(const std::vector<double>& death,
+                const std::vector<double>& birth, const std::string& name) {
+  const int n = birth.size();
+  const std::vector<std::array<int, 2>> ranges{
+      {0, n}, {0, n / 3}, {n / 3, 2 * n / 3}, {n - 7, n}, {5, 6}, {n, n}};
+
+  for (const auto& [begin, end] : ranges) {
+    const auto expected
+        = ps::test::insertion_indexes_brute_force(death, birth, begin, end);
+    const auto indexes = ps::test::insertion_indexes(death, birth, begin, end);
+    check(indexes == expected, name + " sweep [" + std::to_string(begin) + ", "
+                                   + std::to_string(end) + ")");
+  }
+}
+
+void test_online(std::vector<double> death, std::vector<double> birth,
+                 const std::string& name) {
+  // points arrive in order of death
+
+  std::vector<int> order(death.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&](int i, int j) { return death[i] < death[j]; });
+
+  std::vector<double> sorted_death;
+  std::vector<double> sorted_birth;
+  for (const int i : order) {
+    sorted_death.push_back(death[i]);
+    sorted_birth.push_back(birth[i]);
+  }
+
+  ps::test::Online online;
+  std::vector<int> indexes;
+  for (int i = 0; i < sorted_death.size(); i++) {
+    indexes.push_back(online.add(sorted_death[i], sorted_birth[i]));
+  }
+
+  const auto expected = ps::test::insertion_indexes_brute_force(
+      sorted_death, sorted_birth, 0, sorted_death.size());
+  check(indexes == expected, name + " online");
+}
+
+int main() {
+  const int n = 3000;
+  const int nlive = 50;
+
+  for (const double tie : {0., 0.05}) {
+    const std::string ties = tie > 0. ? " with ties" : "";
+    auto [death, birth] = simulate(n, nlive, 1, tie);
+
+    test_online(death, birth, "run" + ties);
+
+    ps::test::sort_by_birth(death, birth);
+    test_sweep(death, birth, "sorted births" + ties);
+
+    permute(death, birth, 2);
+    test_sweep(death, birth, "unsorted births" + ties);
+  }
+
+  if (failures > 0) {
+    std::cerr << failures << " insertion index checks failed\n";
+    return 1;
+  }
+
+  std::cout << "insertion index checks passed\n";
+  return 0;
+}
@@ -0,0 +1,71 @@
+"""
+Test output options
+===================
+"""
+
+import arviz as az
+import pytest
+
+from polystan import from_json, run_polystan
+from examples import example
+
+
+TEST_SETTINGS = {"no-feedback": True, "nlive": 200}
+
+TARGET = example("bernoulli.stan")
+
+
+def stats(data):
+    sample_stats = data['sample_stats']
+    evidence = sample_stats['evidence'].data[0][0]
+    return {"log evidence": evidence['log evidence'],
+            "error log evidence": evidence['error log evidence'],
+            "p-value": sample_stats['test'].data[0][0]['p-value'],
+            "ess": sample_stats['ess'].data[0][0]['n']}
+
+
+def test_in_memory():
+    files = stats(run_polystan(TARGET, polychord=TEST_SETTINGS))
+    in_memory = stats(run_polystan(TARGET, polychord=TEST_SETTINGS,
+                                   output={"in-memory": True}))
+
+    error = max(files["error log evidence"], in_memory["error log evidence"])
+    assert abs(in_memory["log evidence"] - files["log evidence"]) < error
+    assert in_memory["p-value"] == pytest.approx(files["p-value"], rel=1e-6)
+    assert abs(in_memory["ess"] - files["ess"]) <= 1
+
+    samples = from_json("bernoulli.json")
+    assert "theta" in samples.posterior
+    assert "theta" in samples.prior
+
+
+OPTIONS = {
+    "replicate": lambda tmp_path: {"replicate": {"num": 2}},
+    "npy-dir": lambda tmp_path: {"output": {"npy-dir": tmp_path / "npy"}},
+    "zarr-dir": lambda tmp_path: {"output": {"zarr-dir": tmp_path / "zarr"}},
+    "compress": lambda tmp_path: {"output": {"compress": 5}},
+    "archive": lambda tmp_path: {"output": {"archive": tmp_path / "run.zip"}},
+    "stage-dir": lambda tmp_path: {"output": {"stage-dir": tmp_path / "stage"}},
+    "deduplicate": lambda tmp_path: {"output": {"deduplicate": True}},
+    "thin": lambda tmp_path: {"output": {"thin": 5}},
+    "no-samples": lambda tmp_path: {"output": {"no-samples": True}},
+}
+
+
+@pytest.mark.parametrize("option", OPTIONS.keys())
+def test_round_trip(option, tmp_path):
+    kwargs = OPTIONS[option](tmp_path)
+    data = run_polystan(TARGET, polychord=TEST_SETTINGS, **kwargs)
+
+    assert isinstance(data, az.InferenceData)
+    assert "sample_stats" in data
+
+    if option == "no-samples":
+        return
+
+    assert data.posterior["theta"].size > 0
+
+    if option == "zarr-dir":
+        pytest.importorskip("zarr")
+        store = az.InferenceData.from_zarr(str(tmp_path / "zarr"))
+        assert store.posterior["theta"].shape == data.posterior["theta"].shape
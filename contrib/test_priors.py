@@ -38,8 +38,9 @@ def plot_1d(data, x, y, name, **kwargs):
 
 def plot_2d(data, name, **kwargs):
     fig, ax = plt.subplots()
-    az.plot_kde(data["prior"][name + ".1"],
-                data["prior"][name + ".2"], ax=ax, **kwargs)
+    dim = f"{name}_dim_0"
+    az.plot_kde(data["prior"][name].isel({dim: 0}),
+                data["prior"][name].isel({dim: 1}), ax=ax, **kwargs)
     return fig
 
 
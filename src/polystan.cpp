@@ -2,9 +2,13 @@
 #include <iostream>
 #include <optional>
 #include <string>
+#include <vector>
 
 #include "polystan/splash.hpp"
 #include "polystan/model.hpp"
+#include "polystan/monitor.hpp"
+#include "polystan/gzip.hpp"
+#include "polystan/output.hpp"
 #include "polystan/polychord_cli.hpp"
 #include "polystan/version.hpp"
 #include "polystan/metadata.hpp"
@@ -76,7 +80,10 @@ int main(int argc, char** argv) {
 
   CLI::App* pc_cli = app.add_subcommand("polychord", "PolyChord settings");
   bool no_derived = false;
-  ps::AddPolyChord(pc_cli, &settings, no_derived);
+  int timing_samples = 0;
+  double timing_threshold = 0.25;
+  ps::AddPolyChord(pc_cli, &settings, no_derived, timing_samples,
+                   timing_threshold);
 
   CLI::App* data = app.add_subcommand("data", "Data settings");
   std::string data_file_name;
@@ -91,14 +98,159 @@ int main(int argc, char** argv) {
   random->add_option("--seed", seed, "Random seed")
       ->check(CLI::NonNegativeNumber);
 
-  CLI::App* output = app.add_subcommand("output", "Control PolyStan output");
-  std::string json_file_name = std::filesystem::weakly_canonical(
+  CLI::App* replicate = app.add_subcommand(
+      "replicate", "Run independent replicates and merge their results");
+  int replicates = 1;
+  replicate
+      ->add_option("--num", replicates,
+                   "Number of replicates. Replicates run concurrently on "
+                   "separate groups of MPI processes with seeds offset by "
+                   "replicate number. Their dead points are merged into one "
+                   "run with num * nlive live points.")
+      ->check(CLI::PositiveNumber);
+
+  CLI::App* monitor_cli = app.add_subcommand(
+      "monitor", "Test insertion indexes of dead points while running");
+  ps::monitor::Options monitor_options;
+  monitor_cli->add_flag("--log", monitor_options.log,
+                        "Log p-value of latest batch of dead points");
+  monitor_cli
+      ->add_option("--abort-below", monitor_options.threshold,
+                   "Abort the run if the p-value of a batch is below this "
+                   "threshold for --patience consecutive batches. If 0, "
+                   "never abort")
+      ->check(CLI::Range(0., 1.));
+  monitor_cli
+      ->add_option("--patience", monitor_options.patience,
+                   "Number of consecutive batches below threshold before "
+                   "aborting")
+      ->check(CLI::PositiveNumber);
+
+  CLI::App* output_cli
+      = app.add_subcommand("output", "Control PolyStan output");
+  ps::Output output;
+  output.json_file_name = std::filesystem::weakly_canonical(
       std::string(ps::stan_model_name) + ".json");
-  output->add_option("--json-file", json_file_name, "JSON file output name")
+  output_cli
+      ->add_option("--json-file", output.json_file_name,
+                   "JSON file output name")
       ->transform(weakly_canonical);
-  std::string toml_file_name = std::filesystem::weakly_canonical(
+  output_cli->add_flag("--compact", output.format.compact,
+                       "Write JSON without indentation or line breaks");
+  output_cli
+      ->add_option("--significant-digits", output.format.digits,
+                   "Significant digits of samples written to JSON. If 0, "
+                   "write the shortest representation that round-trips")
+      ->check(CLI::Range(0, 17));
+  output_cli->add_flag(
+      "--flat", output.flat,
+      "Write each element of array variables under its own JSON key, e.g., "
+      "x.1, rather than as one multi-dimensional array");
+  output_cli->add_flag(
+      "--deduplicate", output.deduplicate,
+      "Write each run of repeated posterior samples once, with its number of "
+      "repeats in a multiplicity variable");
+  output_cli
+      ->add_option("--thin", output.thinning.factor,
+                   "Write one in this many equally weighted posterior and "
+                   "prior samples, chosen systematically")
+      ->check(CLI::PositiveNumber);
+  output_cli
+      ->add_option("--max-samples", output.thinning.max_samples,
+                   "Maximum number of posterior and of prior samples "
+                   "written, chosen systematically. If 0, no maximum")
+      ->check(CLI::NonNegativeNumber);
+  bool in_memory = false;
+  output_cli->add_flag(
+      "--in-memory", in_memory,
+      "Capture results from PolyChord in memory rather than reading them "
+      "from its files, which are then not written. Prior samples are drawn "
+      "by PolyStan, which evaluates the model at nprior more points per "
+      "replicate, after PolyChord's own prior phase");
+  output_cli
+      ->add_option("--npy-dir", output.npy_dir,
+                   "Also write samples as one NumPy .npy file per variable "
+                   "in this directory, with a JSON manifest of metadata")
+      ->transform(weakly_canonical)
+      ->option_text("DIRNAME");
+  output_cli
+      ->add_option("--zarr-dir", output.zarr_dir,
+                   "Also write InferenceData as a Zarr v2 directory store")
+      ->transform(weakly_canonical)
+      ->option_text("DIRNAME");
+  output_cli
+      ->add_option("--zarr-chunk-size", output.zarr_chunk_size,
+                   "Number of draws per Zarr chunk")
+      ->check(CLI::PositiveNumber);
+  output_cli->add_flag(
+      "--summary", output.summary,
+      "Write means, standard deviations, quantiles and effective sample "
+      "sizes of each parameter, weighted over all dead points, to a summary "
+      "group in the JSON file");
+  output_cli->add_flag(
+      "--sketch", output.sketch,
+      "Write quantiles of each parameter to a quantiles group in the JSON "
+      "file, found from weighted dead points with fixed memory per "
+      "parameter");
+  output_cli->add_flag(
+      "--no-samples", output.no_samples,
+      "Do not load or write equally weighted posterior and prior samples, "
+      "e.g., if only the summary, quantiles or histograms are wanted");
+  output_cli
+      ->add_option("--sketch-quantiles", output.quantiles,
+                   "Quantiles written with --sketch")
+      ->check(CLI::Range(0., 1.))
+      ->delimiter(',');
+  output_cli
+      ->add_option("--histogram-bins", output.histogram_bins,
+                   "Write weighted histograms of each parameter with this "
+                   "many bins, spanning the 0.1% to 99.9% quantiles, to a "
+                   "histograms group in the JSON file. If 0, do not write "
+                   "histograms")
+      ->check(CLI::NonNegativeNumber);
+  std::vector<std::string> histogram_pairs;
+  output_cli
+      ->add_option("--histogram-pairs", histogram_pairs,
+                   "Pairs of parameters, e.g., x:y, of which to also write "
+                   "two-dimensional histograms")
+      ->delimiter(',')
+      ->needs("--histogram-bins");
+  output_cli
+      ->add_option("--compress", output.compress,
+                   "Gzip level of the JSON file and Zarr chunks. PolyChord's "
+                   "text files are compressed after the run. If 0, do not "
+                   "compress")
+      ->check(CLI::Range(0, 9));
+  std::string stage_dir;
+  output_cli
+      ->add_option("--stage-dir", stage_dir,
+                   "Run PolyChord in a directory of each process in this "
+                   "node-local directory, e.g., $TMPDIR, copying files to "
+                   "the base directory whenever they change and once the "
+                   "run ends. Copies replace files by renaming, so partial "
+                   "files are never seen")
+      ->check(CLI::ExistingDirectory)
+      ->transform(weakly_canonical)
+      ->option_text("DIRNAME");
+  double stage_interval = 60.;
+  output_cli
+      ->add_option("--stage-interval", stage_interval,
+                   "Seconds between copies of staged files")
+      ->check(CLI::PositiveNumber)
+      ->needs("--stage-dir");
+  output_cli
+      ->add_option("--archive", output.archive_file_name,
+                   "Pack PolyChord's files and the JSON and TOML files into "
+                   "one uncompressed zip archive with this name after the "
+                   "run, removing the originals. Members are read directly, "
+                   "e.g., as ARCHIVE/model.json")
+      ->transform(weakly_canonical)
+      ->option_text("FILENAME");
+  output.toml_file_name = std::filesystem::weakly_canonical(
       std::string(ps::stan_model_name) + ".toml");
-  output->add_option("--toml-file", toml_file_name, "TOML file output name")
+  output_cli
+      ->add_option("--toml-file", output.toml_file_name,
+                   "TOML file output name")
       ->transform(weakly_canonical);
 
   // add version flags
@@ -116,7 +268,7 @@ int main(int argc, char** argv) {
   // dump cli to toml file
 
   std::ofstream toml_file;
-  toml_file.open(toml_file_name);
+  toml_file.open(output.toml_file_name);
   toml_file << app.config_to_str(true, true);
   toml_file.close();
 
@@ -127,7 +279,27 @@ int main(int argc, char** argv) {
   std::optional<ps::Model> optional_model;
 
   try {
-    optional_model.emplace(data_file_name, seed, settings, no_derived);
+    optional_model.emplace(data_file_name, seed, settings, no_derived,
+                           replicates);
+    optional_model->set_monitor(monitor_options);
+    optional_model->set_in_memory(in_memory);
+    if (!stage_dir.empty()) {
+      optional_model->set_stage(stage_dir, stage_interval);
+    }
+    if (timing_samples > 0) {
+      optional_model->auto_synchronous(timing_samples, timing_threshold);
+    }
+    for (const auto& pair : histogram_pairs) {
+      const auto colon = pair.find(':');
+      const std::string x = pair.substr(0, colon);
+      const std::string y
+          = colon == std::string::npos ? "" : pair.substr(colon + 1);
+      if (optional_model->index(x) < 0 || optional_model->index(y) < 0) {
+        throw std::runtime_error("Unknown parameters in histogram pair "
+                                 + pair);
+      }
+      output.histogram_pairs.emplace_back(x, y);
+    }
   } catch (const std::exception& ex) {
     return app.exit(
         CLI::ConstructionError(ex.what(), CLI::ExitCodes::InvalidError));
@@ -136,16 +308,36 @@ int main(int argc, char** argv) {
   const ps::Model model = optional_model.value();
 
   if (ps::mpi::is_rank_zero()) {
-    std::cout << ps::splash::start(model, toml_file_name) << "\n";
+    std::cout << ps::splash::start(model, output.toml_file_name) << "\n";
   }
 
   ps::mpi::barrier();
 
   model.run();
+  if (output.compress > 0 && !ps::gzip::has_suffix(output.json_file_name)) {
+    output.json_file_name += ps::gzip::SUFFIX;
+  }
+
+  const auto written = model.write(output);
+
+  if (output.compress > 0) {
+    model.compress(output.compress);
+  }
+
+  std::string json_file_name = output.json_file_name;
+  std::string native_file_names = model.basename() + "*";
+
+  if (!output.archive_file_name.empty()) {
+    json_file_name = model.archive(
+        output.archive_file_name,
+        {output.json_file_name, output.toml_file_name});
+    native_file_names = output.archive_file_name;
+  }
 
   if (ps::mpi::is_rank_zero()) {
-    model.write(json_file_name, toml_file_name);
-    std::cout << ps::splash::end(json_file_name, model) << "\n";
+    std::cout << ps::splash::end(json_file_name, native_file_names, model,
+                                 model.results(), written)
+              << "\n";
   }
 
   ps::mpi::finalize();
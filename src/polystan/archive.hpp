@@ -0,0 +1,398 @@
+#ifndef POLYSTAN_ARCHIVE_HPP_
+#define POLYSTAN_ARCHIVE_HPP_
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace polystan {
+namespace archive {
+
+// a zip64 archive of uncompressed members, so that members can be mapped in
+// place and the archive read by standard tools, e.g., Python's zipfile
+
+const char SUFFIX[] = ".zip";
+
+const std::uint32_t LOCAL = 0x04034b50;
+const std::uint32_t CENTRAL = 0x02014b50;
+const std::uint32_t END = 0x06054b50;
+const std::uint32_t END64 = 0x06064b50;
+const std::uint32_t LOCATOR64 = 0x07064b50;
+const std::uint16_t ZIP64 = 0x0001;  // extra field id
+const std::uint16_t VERSION = 45;    // needed for zip64
+const std::uint16_t UTF8 = 0x0800;   // flag for names
+const std::uint16_t DATE = 0x0021;   // 1980-01-01, as no times are kept
+const std::uint32_t MAX32 = 0xffffffff;
+const std::uint16_t MAX16 = 0xffff;
+
+void put(std::string& out, std::uint64_t value, int bytes) {
+  // little endian
+  for (int i = 0; i < bytes; i++) {
+    out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+std::uint64_t get(const char* data, int bytes) {
+  std::uint64_t value = 0;
+  for (int i = bytes - 1; i >= 0; i--) {
+    value = (value << 8) | static_cast<unsigned char>(data[i]);
+  }
+  return value;
+}
+
+bool split(const std::string& path, std::string& archive_file_name,
+           std::string& member) {
+  // split e.g. run.zip/clusters/x.txt into the archive and a member of it;
+  // false if no leading part of the path is an archive
+
+  const std::string suffix(SUFFIX);
+  std::size_t end = path.find('/', 1);
+
+  while (end != std::string::npos) {
+    const std::string prefix = path.substr(0, end);
+    if (prefix.size() > suffix.size()
+        && prefix.compare(prefix.size() - suffix.size(), suffix.size(),
+                          suffix)
+               == 0
+        && std::filesystem::is_regular_file(prefix)) {
+      archive_file_name = prefix;
+      member = path.substr(end + 1);
+      return true;
+    }
+    end = path.find('/', end + 1);
+  }
+
+  return false;
+}
+
+class Writer {
+  // append whole files as members and then write the central directory
+
+ public:
+  explicit Writer(const std::string& file_name_) : file_name(file_name_) {
+    fd = ::open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      throw std::runtime_error("Could not write " + file_name);
+    }
+  }
+
+  Writer(const Writer&) = delete;
+  Writer& operator=(const Writer&) = delete;
+
+  ~Writer() {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+
+  void add(const std::string& member_file_name, const std::string& name) {
+    // copy a file into the archive under name
+
+    const int in = ::open(member_file_name.c_str(), O_RDONLY);
+    if (in < 0) {
+      throw std::runtime_error("Could not read " + member_file_name);
+    }
+
+    Member member{name, 0, offset};
+
+    std::string header;
+    put(header, LOCAL, 4);
+    put(header, VERSION, 2);
+    put(header, UTF8, 2);
+    put(header, 0, 2);  // stored
+    put(header, 0, 2);
+    put(header, DATE, 2);
+    put(header, 0, 4);  // crc, known once copied
+    put(header, MAX32, 4);
+    put(header, MAX32, 4);
+    put(header, name.size(), 2);
+    put(header, 20, 2);
+    header += name;
+    put(header, ZIP64, 2);
+    put(header, 16, 2);
+    const std::size_t sizes = header.size();
+    put(header, 0, 8);  // sizes, known once copied
+    put(header, 0, 8);
+    write(header);
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+    std::vector<char> buffer(1 << 20);
+    ssize_t n;
+
+    while ((n = ::read(in, buffer.data(), buffer.size())) > 0) {
+      crc = crc32(crc, reinterpret_cast<const Bytef*>(buffer.data()), n);
+      write(buffer.data(), n);
+      member.size += n;
+    }
+
+    ::close(in);
+
+    if (n < 0) {
+      throw std::runtime_error("Could not read " + member_file_name);
+    }
+
+    member.crc = crc;
+
+    std::string crc_;
+    put(crc_, member.crc, 4);
+    pwrite(crc_, member.offset + 14);
+
+    std::string sizes_;
+    put(sizes_, member.size, 8);
+    put(sizes_, member.size, 8);
+    pwrite(sizes_, member.offset + sizes);
+
+    members.push_back(member);
+  }
+
+  void close() {
+    const std::uint64_t start = offset;
+
+    for (const auto& member : members) {
+      std::string header;
+      put(header, CENTRAL, 4);
+      put(header, (3 << 8) | VERSION, 2);  // made on unix
+      put(header, VERSION, 2);
+      put(header, UTF8, 2);
+      put(header, 0, 2);
+      put(header, 0, 2);
+      put(header, DATE, 2);
+      put(header, member.crc, 4);
+      put(header, MAX32, 4);
+      put(header, MAX32, 4);
+      put(header, member.name.size(), 2);
+      put(header, 28, 2);
+      put(header, 0, 2);  // comment
+      put(header, 0, 2);  // disk
+      put(header, 0, 2);
+      put(header, 0100644u << 16, 4);  // regular file, rw-r--r--
+      put(header, MAX32, 4);
+      header += member.name;
+      put(header, ZIP64, 2);
+      put(header, 24, 2);
+      put(header, member.size, 8);
+      put(header, member.size, 8);
+      put(header, member.offset, 8);
+      write(header);
+    }
+
+    const std::uint64_t end = offset;
+
+    std::string trailer;
+    put(trailer, END64, 4);
+    put(trailer, 44, 8);
+    put(trailer, (3 << 8) | VERSION, 2);
+    put(trailer, VERSION, 2);
+    put(trailer, 0, 4);
+    put(trailer, 0, 4);
+    put(trailer, members.size(), 8);
+    put(trailer, members.size(), 8);
+    put(trailer, end - start, 8);
+    put(trailer, start, 8);
+
+    put(trailer, LOCATOR64, 4);
+    put(trailer, 0, 4);
+    put(trailer, end, 8);
+    put(trailer, 1, 4);
+
+    put(trailer, END, 4);
+    put(trailer, 0, 2);
+    put(trailer, 0, 2);
+    put(trailer, MAX16, 2);
+    put(trailer, MAX16, 2);
+    put(trailer, MAX32, 4);
+    put(trailer, MAX32, 4);
+    put(trailer, 0, 2);
+    write(trailer);
+
+    if (::close(fd) != 0) {
+      fd = -1;
+      throw std::runtime_error("Could not write " + file_name);
+    }
+    fd = -1;
+  }
+
+ private:
+  struct Member {
+    std::string name;
+    std::uint64_t size;
+    std::uint64_t offset;  // of local header
+    std::uint32_t crc = 0;
+  };
+
+  void write(const char* data, std::size_t size) {
+    std::size_t done = 0;
+    while (done < size) {
+      const ssize_t n = ::write(fd, data + done, size - done);
+      if (n < 0) {
+        throw std::runtime_error("Could not write " + file_name);
+      }
+      done += n;
+    }
+    offset += size;
+  }
+
+  void write(const std::string& data) { write(data.data(), data.size()); }
+
+  void pwrite(const std::string& data, std::uint64_t at) {
+    if (::pwrite(fd, data.data(), data.size(), at)
+        != static_cast<ssize_t>(data.size())) {
+      throw std::runtime_error("Could not write " + file_name);
+    }
+  }
+
+  const std::string file_name;
+  int fd;
+  std::uint64_t offset = 0;
+  std::vector<Member> members;
+};
+
+struct Entry {
+  std::uint64_t offset;  // of data
+  std::uint64_t size;
+  bool stored;  // rather than compressed
+};
+
+class Index {
+  // members of an archive, found from its central directory
+
+ public:
+  explicit Index(const std::string& file_name) {
+    fd = ::open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || info.st_size < 22) {
+      return;
+    }
+
+    // end record is within the last 22 bytes and a comment of up to 64 KiB
+
+    const std::uint64_t size = info.st_size;
+    const std::uint64_t tail_size = std::min<std::uint64_t>(size, 22 + MAX16);
+    const std::string tail = read(size - tail_size, tail_size);
+
+    std::int64_t at = static_cast<std::int64_t>(tail.size()) - 22;
+    while (at >= 0 && get(&tail[at], 4) != END) {
+      at--;
+    }
+    if (at < 0) {
+      return;
+    }
+
+    std::uint64_t count = get(&tail[at + 10], 2);
+    std::uint64_t directory_size = get(&tail[at + 12], 4);
+    std::uint64_t directory = get(&tail[at + 16], 4);
+
+    if (at >= 20 && get(&tail[at - 20], 4) == LOCATOR64) {
+      const std::string end64 = read(get(&tail[at - 12], 8), 56);
+      if (end64.size() < 56 || get(&end64[0], 4) != END64) {
+        return;
+      }
+      count = get(&end64[32], 8);
+      directory_size = get(&end64[40], 8);
+      directory = get(&end64[48], 8);
+    }
+
+    const std::string headers = read(directory, directory_size);
+    std::size_t p = 0;
+
+    for (std::uint64_t i = 0; i < count; i++) {
+      if (p + 46 > headers.size() || get(&headers[p], 4) != CENTRAL) {
+        return;
+      }
+
+      const bool stored = get(&headers[p + 10], 2) == 0;
+      std::uint64_t compressed = get(&headers[p + 20], 4);
+      std::uint64_t uncompressed = get(&headers[p + 24], 4);
+      const std::size_t name_size = get(&headers[p + 28], 2);
+      const std::size_t extra_size = get(&headers[p + 30], 2);
+      const std::size_t comment_size = get(&headers[p + 32], 2);
+      std::uint64_t local = get(&headers[p + 42], 4);
+      const std::string name = headers.substr(p + 46, name_size);
+
+      // zip64 values replace those that are saturated, in this order
+
+      std::size_t q = p + 46 + name_size;
+      const std::size_t extra_end = q + extra_size;
+      while (q + 4 <= extra_end) {
+        const std::uint64_t id = get(&headers[q], 2);
+        const std::size_t field_size = get(&headers[q + 2], 2);
+        if (id == ZIP64) {
+          std::size_t r = q + 4;
+          for (std::uint64_t* value : {&uncompressed, &compressed, &local}) {
+            if (*value == MAX32 && r + 8 <= q + 4 + field_size) {
+              *value = get(&headers[r], 8);
+              r += 8;
+            }
+          }
+        }
+        q += 4 + field_size;
+      }
+
+      entries[name] = {local, stored ? uncompressed : compressed, stored};
+      p = extra_end + comment_size;
+    }
+
+    ok = true;
+  }
+
+  Index(const Index&) = delete;
+  Index& operator=(const Index&) = delete;
+
+  ~Index() {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+
+  explicit operator bool() const { return ok; }
+
+  int descriptor() const { return fd; }
+
+  std::optional<Entry> find(const std::string& name) const {
+    // with offset of data, after local header
+
+    const auto it = entries.find(name);
+    if (it == entries.end()) {
+      return std::nullopt;
+    }
+
+    Entry entry = it->second;
+    const std::string header = read(entry.offset, 30);
+    if (header.size() < 30 || get(&header[0], 4) != LOCAL) {
+      return std::nullopt;
+    }
+    entry.offset += 30 + get(&header[26], 2) + get(&header[28], 2);
+    return entry;
+  }
+
+ private:
+  std::string read(std::uint64_t at, std::uint64_t size) const {
+    std::string data(size, '\0');
+    const ssize_t n = ::pread(fd, &data[0], size, at);
+    data.resize(n > 0 ? n : 0);
+    return data;
+  }
+
+  int fd = -1;
+  bool ok = false;
+  std::unordered_map<std::string, Entry> entries;  // offsets of local headers
+};
+
+}  // end namespace archive
+}  // end namespace polystan
+
+#endif  // POLYSTAN_ARCHIVE_HPP_
@@ -0,0 +1,268 @@
+#ifndef POLYSTAN_ASYNC_HPP_
+#define POLYSTAN_ASYNC_HPP_
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "polystan/gzip.hpp"
+#include "polystan/timing.hpp"
+
+namespace polystan {
+namespace async {
+
+struct Report {
+  std::uint64_t bytes = 0;
+  double write_time = 0.;  // spent compressing and writing on the thread
+  double stall_time = 0.;  // spent waiting for a free buffer
+
+  double avoided() const { return std::max(write_time - stall_time, 0.); }
+
+  Report& operator+=(const Report& other) {
+    bytes += other.bytes;
+    write_time += other.write_time;
+    stall_time += other.stall_time;
+    return *this;
+  }
+};
+
+class Writer {
+  // writes to a file on a dedicated thread. the caller fills one buffer while
+  // the thread writes the other; they are handed over under a mutex, and
+  // each side sleeps on a condition variable until the other hands a buffer
+  // back, so the caller only waits if both buffers are full. data is gzip
+  // compressed on the thread if level > 0. satisfies the rapidjson output
+  // stream concept
+
+ public:
+  typedef char Ch;
+
+  explicit Writer(const std::string& file_name,
+                  std::size_t buffer_size = 1 << 22, int level = 0)
+      : fd(::open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)),
+        owner(true) {
+    if (fd < 0) {
+      throw std::runtime_error("Could not write " + file_name);
+    }
+    if (level > 0) {
+      deflate = std::make_unique<gzip::Deflate>(level);
+    }
+    start(buffer_size);
+  }
+
+  explicit Writer(int fd, std::size_t buffer_size = 1 << 16)
+      : fd(fd), owner(false) {
+    start(buffer_size);
+  }
+
+  Writer(const Writer&) = delete;
+  Writer& operator=(const Writer&) = delete;
+
+  ~Writer() {
+    try {
+      close();
+    } catch (...) {
+    }
+  }
+
+  void write(const char* data, std::size_t size) {
+    while (size > 0) {
+      auto& buffer = buffers[current];
+      const std::size_t n = std::min(size, buffer.size() - sizes[current]);
+      std::memcpy(buffer.data() + sizes[current], data, n);
+      sizes[current] += n;
+      data += n;
+      size -= n;
+
+      if (sizes[current] == buffer.size()) {
+        flush();
+      }
+    }
+  }
+
+  void write(const std::string& data) { write(data.data(), data.size()); }
+
+  void Put(char c) {
+    buffers[current][sizes[current]++] = c;
+    if (sizes[current] == buffers[current].size()) {
+      flush();
+    }
+  }
+
+  void Flush() {}
+
+  void flush() {
+    // hand the current buffer to the writer thread
+
+    if (sizes[current] == 0) {
+      return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    full[current] = true;
+    ready.notify_one();
+    current ^= 1;
+
+    if (full[current]) {
+      const timing::Timer timer;
+      emptied.wait(lock, [this] { return !full[current]; });
+      report_.stall_time += timer.elapsed();
+    }
+  }
+
+  const Report& close() {
+    // write everything and stop the thread
+
+    if (thread.joinable()) {
+      flush();
+      {
+        const std::lock_guard<std::mutex> lock(mutex);
+        closing = true;
+        ready.notify_one();
+      }
+      thread.join();
+
+      if (owner) {
+        ::close(fd);
+      }
+
+      if (error != 0) {
+        throw std::runtime_error(std::string("Could not write: ")
+                                 + std::strerror(error));
+      }
+    }
+
+    return report_;
+  }
+
+  const Report& report() const { return report_; }
+
+ private:
+  void start(std::size_t buffer_size) {
+    for (auto& buffer : buffers) {
+      buffer.resize(std::max<std::size_t>(buffer_size, 1));
+    }
+    thread = std::thread([this] { loop(); });
+  }
+
+  void loop() {
+    int k = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+      // sleep until handed a buffer or closed
+      ready.wait(lock, [&] { return full[k] || closing; });
+
+      if (full[k]) {
+        lock.unlock();
+        const timing::Timer timer;
+        if (deflate) {
+          compressed.clear();
+          (*deflate)(buffers[k].data(), sizes[k], false, compressed);
+          write_all(compressed.data(), compressed.size());
+          report_.bytes += compressed.size();
+        } else {
+          write_all(buffers[k].data(), sizes[k]);
+          report_.bytes += sizes[k];
+        }
+        report_.write_time += timer.elapsed();
+        sizes[k] = 0;
+        lock.lock();
+        full[k] = false;
+        emptied.notify_one();
+        k ^= 1;
+        continue;
+      }
+
+      // closing, and every buffer has been written
+      lock.unlock();
+      if (deflate) {
+        compressed.clear();
+        (*deflate)(nullptr, 0, true, compressed);
+        write_all(compressed.data(), compressed.size());
+        report_.bytes += compressed.size();
+      }
+      return;
+    }
+  }
+
+  void write_all(const char* data, std::size_t size) {
+    while (size > 0 && error == 0) {
+      const ssize_t n = ::write(fd, data, size);
+      if (n < 0) {
+        if (errno != EINTR) {
+          error = errno;
+        }
+        continue;
+      }
+      data += n;
+      size -= n;
+    }
+  }
+
+  const int fd;
+  const bool owner;
+  std::array<std::vector<char>, 2> buffers;
+  std::array<std::size_t, 2> sizes{0, 0};
+  std::array<bool, 2> full{false, false};  // guarded by mutex
+  bool closing = false;
+  int current = 0;
+  int error = 0;
+  Report report_;
+  std::unique_ptr<gzip::Deflate> deflate;
+  std::string compressed;
+  std::mutex mutex;
+  std::condition_variable ready;    // a buffer is full, or closing
+  std::condition_variable emptied;  // a buffer has been written
+  std::thread thread;
+};
+
+class Files {
+  // writes a sequence of files, each finishing in the background while the
+  // next ones are filled
+
+ public:
+  explicit Files(int level = 0) : level(level) {}
+
+  Writer& open(const std::string& file_name, std::size_t size) {
+    while (pending.size() > 1) {
+      report_ += pending.front()->close();
+      pending.pop_front();
+    }
+    const std::size_t buffer_size = std::min<std::size_t>(size, 1 << 22);
+    pending.push_back(
+        std::make_unique<Writer>(file_name, buffer_size, level));
+    return *pending.back();
+  }
+
+  const Report& close() {
+    while (!pending.empty()) {
+      report_ += pending.front()->close();
+      pending.pop_front();
+    }
+    return report_;
+  }
+
+ private:
+  const int level;
+  std::deque<std::unique_ptr<Writer>> pending;
+  Report report_;
+};
+
+}  // end namespace async
+}  // end namespace polystan
+
+#endif  // POLYSTAN_ASYNC_HPP_
@@ -0,0 +1,95 @@
+#ifndef POLYSTAN_CAPTURE_HPP_
+#define POLYSTAN_CAPTURE_HPP_
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <optional>
+#include <vector>
+
+#include "polystan/read.hpp"
+#include "polystan/test.hpp"
+
+namespace polystan {
+namespace capture {
+
+class Run {
+  // dead points and evidence of a run as passed to PolyChord's dumper, so
+  // that results needn't be read from files. rows of live and dead points
+  // are parameters, derived parameters, loglike and birth loglike
+
+ public:
+  void add_dead(int nrows, int npars, const double* rows,
+                const std::vector<int>& indexes_ = {}) {
+    // insertion indexes of the rows, if found already, e.g., by a monitor
+    // sharing online
+
+    if (columns.empty()) {
+      columns.resize(npars - 1);
+    }
+
+    for (int i = 0; i < nrows; ++i) {
+      add(rows + i * npars, npars,
+          indexes_.empty() ? std::nullopt : std::optional<int>(indexes_[i]));
+    }
+
+    held = true;
+  }
+
+  void set_live(int nlive, int npars, const double* live, double logz,
+                double logzerr) {
+    live_.assign(live, live + nlive * npars);
+    npars_ = npars;
+    evidence = {logz, logzerr};
+    held = true;
+  }
+
+  void finish() {
+    // remaining live points die in order of loglike
+
+    const int nlive = held ? live_.size() / npars_ : 0;
+    std::vector<int> order(nlive);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](int i, int j) -> bool {
+      return live_[i * npars_ + npars_ - 2] < live_[j * npars_ + npars_ - 2];
+    });
+
+    for (const int i : order) {
+      add(live_.data() + i * npars_, npars_, std::nullopt);
+    }
+
+    std::vector<double>().swap(live_);
+  }
+
+  const std::vector<double>& death() const {
+    static const std::vector<double> none;
+    return held ? columns[0] : none;
+  }
+
+  bool held = false;  // whether this process captured the run
+  read::Columns columns;  // loglike, parameters and derived parameters
+  std::vector<double> birth;
+  std::vector<int> indexes;  // insertion indexes, found as points die
+  std::array<double, 2> evidence;
+  test::Online online;  // of every point that died, shared with any monitor
+
+ private:
+  void add(const double* row, int npars, std::optional<int> index) {
+    columns[0].push_back(row[npars - 2]);
+    for (int i = 0; i < npars - 2; ++i) {
+      columns[i + 1].push_back(row[i]);
+    }
+    birth.push_back(row[npars - 1]);
+    indexes.push_back(index.has_value()
+                          ? index.value()
+                          : online.add(row[npars - 2], row[npars - 1]));
+  }
+
+  std::vector<double> live_;
+  int npars_ = 0;
+};
+
+}  // end namespace capture
+}  // end namespace polystan
+
+#endif  // POLYSTAN_CAPTURE_HPP_
@@ -0,0 +1,173 @@
+#ifndef POLYSTAN_GZIP_HPP_
+#define POLYSTAN_GZIP_HPP_
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace polystan {
+namespace gzip {
+
+const char SUFFIX[] = ".gz";
+
+bool has_suffix(const std::string& file_name) {
+  const std::string suffix(SUFFIX);
+  return file_name.size() >= suffix.size()
+         && file_name.compare(file_name.size() - suffix.size(), suffix.size(),
+                              suffix)
+                == 0;
+}
+
+class Deflate {
+  // streaming gzip compression
+
+ public:
+  explicit Deflate(int level) {
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    // 16 selects a gzip rather than zlib wrapper
+    if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8,
+                     Z_DEFAULT_STRATEGY)
+        != Z_OK) {
+      throw std::runtime_error("Could not initialize gzip compression");
+    }
+  }
+
+  Deflate(const Deflate&) = delete;
+  Deflate& operator=(const Deflate&) = delete;
+
+  ~Deflate() { deflateEnd(&stream); }
+
+  void operator()(const char* data, std::size_t size, bool finish,
+                  std::string& out) {
+    // append compressed data to out, ending the stream if finish
+
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream.avail_in = size;
+
+    const std::size_t start = out.size();
+    out.resize(start + deflateBound(&stream, size) + 64);
+    std::size_t used = start;
+    int status;
+
+    do {
+      if (used == out.size()) {
+        out.resize(2 * out.size());
+      }
+      stream.next_out = reinterpret_cast<Bytef*>(&out[used]);
+      stream.avail_out = out.size() - used;
+      status = deflate(&stream, finish ? Z_FINISH : Z_NO_FLUSH);
+      if (status == Z_STREAM_ERROR) {
+        throw std::runtime_error("Could not compress data");
+      }
+      used = out.size() - stream.avail_out;
+    } while (stream.avail_out == 0 || (finish && status != Z_STREAM_END));
+
+    out.resize(used);
+  }
+
+ private:
+  z_stream stream;
+};
+
+void compress_file(const std::string& file_name, int level) {
+  // replace a file by a gzip compressed copy
+
+  std::ifstream ifs(file_name, std::ios::binary);
+
+  if (!ifs) {
+    throw std::runtime_error("Could not read " + file_name);
+  }
+
+  const std::string gz_file_name = file_name + SUFFIX;
+  std::ofstream ofs(gz_file_name, std::ios::binary);
+
+  if (!ofs) {
+    throw std::runtime_error("Could not write " + gz_file_name);
+  }
+
+  Deflate deflate(level);
+  std::string in(1 << 20, '\0');
+  std::string out;
+
+  while (ifs) {
+    ifs.read(&in[0], in.size());
+    out.clear();
+    deflate(in.data(), ifs.gcount(), !ifs, out);
+    ofs.write(out.data(), out.size());
+  }
+
+  if (!ofs.flush()) {
+    throw std::runtime_error("Could not write " + gz_file_name);
+  }
+
+  std::filesystem::remove(file_name);
+}
+
+bool decompress(const char* data, std::size_t size, std::string& out) {
+  // inflate gzip data held in memory, returning false if it is not valid
+
+  z_stream stream;
+  stream.zalloc = Z_NULL;
+  stream.zfree = Z_NULL;
+  stream.opaque = Z_NULL;
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+  stream.avail_in = size;
+
+  if (inflateInit2(&stream, 15 + 16) != Z_OK) {
+    return false;
+  }
+
+  out.resize(std::max<std::size_t>(4 * size, 1 << 16));
+  std::size_t used = 0;
+  int status;
+
+  do {
+    if (used == out.size()) {
+      out.resize(2 * out.size());
+    }
+    stream.next_out = reinterpret_cast<Bytef*>(&out[used]);
+    stream.avail_out = out.size() - used;
+    status = inflate(&stream, Z_NO_FLUSH);
+    used = out.size() - stream.avail_out;
+  } while (status == Z_OK);
+
+  inflateEnd(&stream);
+  out.resize(used);
+  return status == Z_STREAM_END;
+}
+
+bool decompress_file(const std::string& gz_file_name, std::string& data) {
+  // read a whole gzip file, returning false if it could not be read
+
+  gzFile file = gzopen(gz_file_name.c_str(), "rb");
+
+  if (file == nullptr) {
+    return false;
+  }
+
+  gzbuffer(file, 1 << 20);
+  data.clear();
+  std::size_t size = 0;
+  int n;
+
+  do {
+    data.resize(size + (1 << 22));
+    n = gzread(file, &data[size], 1 << 22);
+    size += n > 0 ? n : 0;
+  } while (n > 0);
+
+  data.resize(size);
+  gzclose(file);
+  return n == 0;
+}
+
+}  // end namespace gzip
+}  // end namespace polystan
+
+#endif  // POLYSTAN_GZIP_HPP_
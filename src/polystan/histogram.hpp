@@ -0,0 +1,123 @@
+#ifndef POLYSTAN_HISTOGRAM_HPP_
+#define POLYSTAN_HISTOGRAM_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "polystan/json.hpp"
+#include "polystan/mpi.hpp"
+
+namespace polystan {
+namespace histogram {
+
+struct Axis {
+  double lower;
+  double upper;
+  int bins;
+
+  int index(double x) const {
+    // bin of x, or -1 if outside the range
+
+    if (!(x >= lower && x <= upper)) {
+      return -1;
+    }
+    const int i = (x - lower) / (upper - lower) * bins;
+    return std::min(i, bins - 1);
+  }
+
+  std::vector<double> edges() const {
+    std::vector<double> data(bins + 1);
+    for (int i = 0; i <= bins; i++) {
+      data[i] = lower + (upper - lower) * i / bins;
+    }
+    return data;
+  }
+};
+
+class Histogram {
+  // weighted histogram in one or two dimensions. weight outside the axes is
+  // counted separately
+
+ public:
+  explicit Histogram(const std::vector<Axis>& axes) : axes(axes) {
+    std::size_t size = 1;
+    for (const auto& axis : axes) {
+      size *= axis.bins;
+    }
+    weights.resize(size, 0.);
+  }
+
+  void add(const std::vector<double>& x, double w) {
+    // x holds a coordinate for each axis
+
+    std::size_t flat = 0;
+    for (int i = 0; i < axes.size(); i++) {
+      const int index = axes[i].index(x[i]);
+      if (index < 0) {
+        outside += w;
+        return;
+      }
+      flat = flat * axes[i].bins + index;
+    }
+    weights[flat] += w;
+  }
+
+  void merge(const Histogram& other) {
+    for (int i = 0; i < weights.size(); i++) {
+      weights[i] += other.weights[i];
+    }
+    outside += other.outside;
+  }
+
+  void gather() {
+    // sum over every process on rank zero
+
+    std::vector<double> local(weights);
+    local.push_back(outside);
+    const auto global = mpi::gather(local);
+
+    if (mpi::is_rank_zero()) {
+      const std::size_t n = local.size();
+      for (std::size_t i = n; i < global.size(); i++) {
+        const std::size_t j = i % n;
+        if (j + 1 == n) {
+          outside += global[i];
+        } else {
+          weights[j] += global[i];
+        }
+      }
+    }
+  }
+
+  void add_to(json::Object& object, const std::string& name) const {
+    json::Object entry = to_object();
+    object.add(name, entry);
+  }
+
+  json::Object to_object() const {
+    const char* const labels[] = {"x edges", "y edges"};
+
+    json::Object entry;
+    if (axes.size() == 1) {
+      entry.add("edges", axes[0].edges());
+    } else {
+      for (int i = 0; i < axes.size(); i++) {
+        entry.add(labels[i], axes[i].edges());
+      }
+    }
+    entry.add("weights", weights);
+    entry.add("weight outside", outside);
+    return entry;
+  }
+
+  std::vector<Axis> axes;
+  std::vector<double> weights;  // row-major for two dimensions
+  double outside = 0.;
+};
+
+}  // end namespace histogram
+}  // end namespace polystan
+
+#endif  // POLYSTAN_HISTOGRAM_HPP_
@@ -4,19 +4,39 @@
 #include <rapidjson/document.h>
 #include <rapidjson/ostreamwrapper.h>
 #include <rapidjson/prettywriter.h>
+#include <rapidjson/writer.h>
 
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <string>
 #include <fstream>
+#include <optional>
 #include <sstream>
+#include <stdexcept>
 #include <utility>
 #include <vector>
 
+#include "polystan/async.hpp"
+
 namespace polystan {
 namespace json {
 
 namespace rj = rapidjson;
 typedef rapidjson::MemoryPoolAllocator<> Alloc;
 
+// non-finite numbers are written as NaN, Infinity and -Infinity, as
+// understood by Python, rather than stopping the writer part-way
+template <typename OutputStream>
+using Writer = rj::Writer<OutputStream, rj::UTF8<>, rj::UTF8<>,
+                          rj::CrtAllocator, rj::kWriteNanAndInfFlag>;
+template <typename OutputStream>
+using PrettyWriter
+    = rj::PrettyWriter<OutputStream, rj::UTF8<>, rj::UTF8<>, rj::CrtAllocator,
+                       rj::kWriteNanAndInfFlag>;
+
 Alloc& get_allocator() {
   static rj::GenericDocument<rj::UTF8<>> doc;
   return doc.GetAllocator();
@@ -38,6 +58,15 @@ rj::Value String(const std::string& str, Alloc& alloc) {
   return value;
 }
 
+rj::Value Vector(const std::vector<std::string>& vec, Alloc& alloc) {
+  rj::Value value(rj::kArrayType);
+  value.Reserve(vec.size(), alloc);
+  for (const std::string& elem : vec) {
+    value.PushBack(String(elem, alloc).Move(), alloc);
+  }
+  return value;
+}
+
 class Object {
  public:
   Object() : value(rj::kObjectType), alloc(get_allocator()) {}
@@ -73,6 +102,33 @@ class Object {
     value.AddMember(String(name, alloc).Move(), child.value.Move(), alloc);
   }
 
+  template <typename T>
+  void add(const std::string& name, std::vector<T>& elements,
+           const std::vector<int>& shape) {
+    // row-major elements, e.g., numbers or objects, as arrays nested to
+    // shape, or the one element if shape is empty. objects are moved
+
+    std::size_t offset = 0;
+    rj::Value nested = nest(elements, shape, 0, offset);
+    value.AddMember(String(name, alloc).Move(), nested.Move(), alloc);
+  }
+
+  void add_null(const std::string& name) {
+    rj::Value null;
+    value.AddMember(String(name, alloc).Move(), null.Move(), alloc);
+  }
+
+  void merge(const Object& other) {
+    for (auto it = other.value.MemberBegin(); it != other.value.MemberEnd();
+         ++it) {
+      rj::Value name;
+      rj::Value copy;
+      name.CopyFrom(it->name, alloc);
+      copy.CopyFrom(it->value, alloc);
+      value.AddMember(name.Move(), copy.Move(), alloc);
+    }
+  }
+
   void copy(const std::string& name, const Object& child) {
     rj::Value copy;
     copy.CopyFrom(child.value, alloc);
@@ -88,15 +144,175 @@ class Object {
   void write(const std::string& json_file_name) {
     std::ofstream ofs(json_file_name);
     rj::OStreamWrapper osw(ofs);
-    rj::PrettyWriter<rj::OStreamWrapper> writer(osw);
-    value.Accept(writer);
+    PrettyWriter<rj::OStreamWrapper> writer(osw);
+    accept(writer);
+  }
+
+  template <typename Writer_>
+  void accept(Writer_& writer) const {
+    if (!value.Accept(writer)) {
+      throw std::runtime_error("Could not write JSON value");
+    }
   }
 
  private:
+  rj::Value element(double x) { return rj::Value(x); }
+
+  rj::Value element(Object& x) {
+    rj::Value moved;
+    moved = x.value.Move();
+    return moved;
+  }
+
+  template <typename T>
+  rj::Value nest(std::vector<T>& elements, const std::vector<int>& shape,
+                 int dim, std::size_t& offset) {
+    if (dim == shape.size()) {
+      return element(elements[offset++]);
+    }
+
+    rj::Value array(rj::kArrayType);
+    array.Reserve(shape[dim], alloc);
+    for (int i = 0; i < shape[dim]; i++) {
+      rj::Value nested = nest(elements, shape, dim + 1, offset);
+      array.PushBack(nested.Move(), alloc);
+    }
+    return array;
+  }
+
   Alloc& alloc;
   rj::Value value;
 };
 
+struct Format {
+  bool compact = false;
+  int digits = 0;  // significant digits; if 0, shortest that round-trips
+};
+
+int to_chars(char* buffer, int size, double value, int digits) {
+  // JSON has no non-finite numbers; write as understood by Python. they are
+  // found from the IEEE 754 bits, as std::isnan and std::isinf are always
+  // false under -ffinite-math-only, which -Ofast sets
+
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const std::uint64_t exponent = 0x7ff0000000000000;
+  const std::uint64_t mantissa = 0x000fffffffffffff;
+
+  if ((bits & exponent) == exponent) {
+    if ((bits & mantissa) != 0) {
+      return std::snprintf(buffer, size, "NaN");
+    }
+    return std::snprintf(buffer, size, bits >> 63 ? "-Infinity" : "Infinity");
+  }
+
+#if __cpp_lib_to_chars >= 201611L
+  const auto result
+      = digits > 0 ? std::to_chars(buffer, buffer + size, value,
+                                   std::chars_format::general, digits)
+                   : std::to_chars(buffer, buffer + size, value);
+  return result.ptr - buffer;
+#else
+  return std::snprintf(buffer, size, "%.*g", digits > 0 ? digits : 17, value);
+#endif
+}
+
+class Stream {
+  // write a document piece by piece rather than building it in memory first
+
+ public:
+  explicit Stream(const std::string& json_file_name,
+                  const Format& format = Format(), int level = 0)
+      : out(json_file_name, 1 << 22, level), digits(format.digits) {
+    if (format.compact) {
+      compact.emplace(out);
+    } else {
+      pretty.emplace(out);
+    }
+  }
+
+  void key(const std::string& name) {
+    visit([&](auto& writer) { writer.Key(name.c_str(), name.size(), true); });
+  }
+
+  void start_object() {
+    visit([](auto& writer) { writer.StartObject(); });
+  }
+
+  void end_object() {
+    visit([](auto& writer) { writer.EndObject(); });
+  }
+
+  void start_array() {
+    visit([](auto& writer) { writer.StartArray(); });
+  }
+
+  void end_array() {
+    visit([](auto& writer) { writer.EndArray(); });
+  }
+
+  void values(const double* first, const double* last) {
+    visit([&](auto& writer) {
+      char buffer[32];
+      for (const double* elem = first; elem != last; ++elem) {
+        const int size = to_chars(buffer, sizeof(buffer), *elem, digits);
+        writer.RawValue(buffer, size, rj::kNumberType);
+      }
+    });
+  }
+
+  void values(const std::vector<double>& data) {
+    values(data.data(), data.data() + data.size());
+  }
+
+  void array(const double* data, const std::vector<int>& shape, int dim = 0) {
+    // row-major data of this shape as nested arrays
+
+    start_array();
+    if (dim + 1 >= shape.size()) {
+      values(data, data + (shape.empty() ? 1 : shape[dim]));
+    } else {
+      std::size_t stride = 1;
+      for (int d = dim + 1; d < shape.size(); d++) {
+        stride *= shape[d];
+      }
+      for (int i = 0; i < shape[dim]; i++) {
+        array(data + i * stride, shape, dim + 1);
+      }
+    }
+    end_array();
+  }
+
+  void add(const std::string& name, const Object& object) {
+    key(name);
+    visit([&](auto& writer) { object.accept(writer); });
+  }
+
+  void add(const std::string& name, const std::string& data) {
+    key(name);
+    visit([&](auto& writer) {
+      writer.String(data.c_str(), data.size(), true);
+    });
+  }
+
+  const async::Report& close() { return out.close(); }
+
+ private:
+  template <typename F>
+  void visit(F f) {
+    if (compact.has_value()) {
+      f(compact.value());
+    } else {
+      f(pretty.value());
+    }
+  }
+
+  async::Writer out;
+  const int digits;
+  std::optional<Writer<async::Writer>> compact;
+  std::optional<PrettyWriter<async::Writer>> pretty;
+};
+
 }  // end namespace json
 }  // end namespace polystan
 
@@ -0,0 +1,103 @@
+#ifndef POLYSTAN_MERGE_HPP_
+#define POLYSTAN_MERGE_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+namespace polystan {
+namespace merge {
+
+void sort_by_death(std::vector<double>& death, std::vector<double>& birth) {
+  std::vector<int> order(death.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(),
+            [&](int i, int j) -> bool { return death[i] < death[j]; });
+
+  std::vector<double> ordered_birth(birth.size());
+  std::transform(order.begin(), order.end(), ordered_birth.begin(),
+                 [&](int i) { return birth[i]; });
+
+  birth = ordered_birth;
+  std::sort(death.begin(), death.end());
+}
+
+std::vector<int> nlive(const std::vector<double>& death,
+                       const std::vector<double>& birth) {
+  // number of points alive at each death contour, i.e., born below and dying
+  // at or above it. death must be sorted
+
+  std::vector<double> sorted_birth(birth);
+  std::sort(sorted_birth.begin(), sorted_birth.end());
+
+  std::vector<int> n(death.size());
+
+  for (int i = 0; i < death.size(); ++i) {
+    const auto born = std::lower_bound(sorted_birth.begin(),
+                                       sorted_birth.end(), death[i])
+                      - sorted_birth.begin();
+    const auto died = std::lower_bound(death.begin(), death.end(), death[i])
+                      - death.begin();
+    n[i] = std::max(static_cast<int>(born - died), 1);
+  }
+
+  return n;
+}
+
+double logsumexp(const std::vector<double>& x) {
+  const double max = *std::max_element(x.begin(), x.end());
+  double sum = 0.;
+  for (const double& e : x) {
+    sum += std::exp(e - max);
+  }
+  return max + std::log(sum);
+}
+
+std::vector<double> log_weights(const std::vector<double>& death,
+                                const std::vector<double>& birth) {
+  // log of prior volume times likelihood for each dead point, using the
+  // expected shrinkage log t = -1 / nlive. death must be sorted
+
+  const std::vector<int> n = nlive(death, birth);
+  std::vector<double> log_w(death.size());
+  double log_x = 0.;
+
+  for (int i = 0; i < death.size(); ++i) {
+    log_w[i] = death[i] + log_x + std::log(-std::expm1(-1. / n[i]));
+    log_x -= 1. / n[i];
+  }
+
+  return log_w;
+}
+
+std::array<double, 2> evidence(const std::vector<double>& log_w,
+                               const std::vector<double>& death,
+                               int nlive_total) {
+  // error from information H ~ log(1 / posterior volume)
+
+  const double logz = logsumexp(log_w);
+  double h = 0.;
+
+  for (int i = 0; i < log_w.size(); ++i) {
+    h += std::exp(log_w[i] - logz) * (death[i] - logz);
+  }
+
+  return {logz, std::sqrt(std::max(h, 0.) / nlive_total)};
+}
+
+double ess(const std::vector<double>& log_w) {
+  const double logz = logsumexp(log_w);
+  double sum = 0.;
+  for (const double& e : log_w) {
+    sum += std::exp(2. * (e - logz));
+  }
+  return 1. / sum;
+}
+
+}  // end namespace merge
+}  // end namespace polystan
+
+#endif  // POLYSTAN_MERGE_HPP_
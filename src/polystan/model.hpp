@@ -1,9 +1,18 @@
 #ifndef POLYSTAN_MODEL_HPP_
 #define POLYSTAN_MODEL_HPP_
 
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
 #include <ctime>
 #include <filesystem>
+#include <iostream>
 #include <limits>
+#include <mutex>
+#include <numeric>
 #include <optional>
 #include <regex>
 #include <string>
@@ -11,12 +20,30 @@
 #include <vector>
 
 #include "polystan/read.hpp"
+#include "polystan/archive.hpp"
+#include "polystan/async.hpp"
+#include "polystan/capture.hpp"
 #include "polystan/json.hpp"
+#include "polystan/gzip.hpp"
+#include "polystan/histogram.hpp"
+#include "polystan/merge.hpp"
 #include "polystan/read_err.hpp"
 #include "polystan/version.hpp"
 #include "polystan/metadata.hpp"
+#include "polystan/monitor.hpp"
 #include "polystan/mpi.hpp"
+#include "polystan/npy.hpp"
+#include "polystan/output.hpp"
+#include "polystan/pipeline.hpp"
+#include "polystan/rng.hpp"
+#include "polystan/sketch.hpp"
+#include "polystan/stage.hpp"
+#include "polystan/summary.hpp"
 #include "polystan/test.hpp"
+#include "polystan/thin.hpp"
+#include "polystan/timing.hpp"
+#include "polystan/variables.hpp"
+#include "polystan/zarr.hpp"
 
 #include "bridgestan/src/bridgestan.h"
 #include "polychord/interfaces.hpp"
@@ -26,6 +53,8 @@ namespace polystan {
 const double LOG_ZERO_STAN
     = -0.5e30;  // set greater than PolyChord default log zero
 
+const int ABORT_CODE = 3;  // exit code of runs stopped by the monitor
+
 std::optional<std::string> unconstrain_err(const bs_model* model,
                                            const std::vector<double>& theta) {
   double* theta_unc = new double[theta.size()];
@@ -55,11 +84,11 @@ bs_model* make_bs_model(const std::string& data_file_name, unsigned int seed) {
   return model;
 }
 
-bs_rng* make_bs_rng(const bs_model* model, unsigned int seed) {
-  if (bs_param_num(model, false, true) == bs_param_num(model, false, false)) {
-    return nullptr;
-  }
+bool generated_quantities(const bs_model* model) {
+  return bs_param_num(model, false, true) != bs_param_num(model, false, false);
+}
 
+bs_rng* make_bs_rng(unsigned int seed) {
   char* err;
   bs_rng* rng = bs_rng_construct(seed, &err);
 
@@ -70,8 +99,8 @@ bs_rng* make_bs_rng(const bs_model* model, unsigned int seed) {
   return rng;
 }
 
-double loglike(const bs_model* model, bs_rng* rng, double* theta, int ndim,
-               double* phi, int nderived) {
+double loglike(const bs_model* model, bool gq, unsigned int seed,
+               double* theta, int ndim, double* phi, int nderived) {
   int err_code = 0;
   char* err;
 
@@ -87,9 +116,18 @@ double loglike(const bs_model* model, bs_rng* rng, double* theta, int ndim,
   // constrain parameters to compute derived
 
   if (nderived > 0) {
+    // generated quantities draw from a generator seeded by the seed and the
+    // point, so are reproducible on any process and in any order
+
+    bs_rng* generator
+        = gq ? make_bs_rng(rng::point_seed(seed, theta, ndim)) : nullptr;
     double* theta_phi = new double[ndim + nderived];
-    err_code = bs_param_constrain(model, true, rng != nullptr, theta_unc,
-                                  theta_phi, rng, &err);
+    err_code = bs_param_constrain(model, true, gq, theta_unc, theta_phi,
+                                  generator, &err);
+
+    if (generator != nullptr) {
+      bs_rng_destruct(generator);
+    }
 
     if (err_code != 0) {
       throw std::runtime_error(add_to_err(err));
@@ -122,15 +160,38 @@ double loglike(const bs_model* model, bs_rng* rng, double* theta, int ndim,
   return loglike;
 }
 
+struct Results {
+  // summaries of a run, missing if PolyChord did not write their files
+
+  std::optional<std::array<double, 2>> evidence;
+  std::optional<std::array<std::vector<double>, 2>> replicate_evidences;
+  std::optional<double> p_value;
+  std::optional<int> ess;
+  std::optional<int> neval;
+  timing::LoadBalance load_balance;
+  std::vector<double> weights;  // normalized, of the dead points of the
+                                // merged run that this process reads
+};
+
+struct Summaries {
+  // of each parameter from weighted dead points, missing if not asked for or
+  // if PolyChord did not write dead points
+
+  std::optional<std::vector<summary::Stats>> stats;
+  std::optional<std::vector<sketch::TDigest>> sketches;
+  std::optional<std::vector<histogram::Histogram>> histograms;
+};
+
 class Model {
  public:
   Model(const std::string& data_file_name, unsigned int seed,
-        const Settings& settings, bool no_derived)
+        const Settings& settings, bool no_derived, int replicates = 1)
       : seed(seed),
         _no_derived(no_derived),
+        replicates(replicates),
         data_file_name(data_file_name),
         model(make_bs_model(data_file_name, seed)),
-        rng(make_bs_rng(model, seed)),
+        gq(generated_quantities(model)),
         settings(settings) {
     check_unit_hypercube();
     fix_settings();
@@ -172,6 +233,48 @@ class Model {
     }
   }
 
+  void set_monitor(const monitor::Options& options) {
+    monitor_options = options;
+  }
+
+  void set_stage(const std::string& stage_dir_, double interval) {
+    // PolyChord writes to a directory of this process in stage_dir_, from
+    // which files are copied to the base directory in the background
+    stage_dir = stage_dir_;
+    stage_interval = interval;
+  }
+
+  void set_in_memory(bool in_memory_) {
+    // capture results through PolyChord's dumper rather than its files
+    in_memory = in_memory_;
+    captures.resize(in_memory ? replicates : 0);
+  }
+
+  void auto_synchronous(int nsamples, double threshold) {
+    // time likelihood evaluations at prior draws, shared between processes.
+    // synchronous workers wait for the slowest worker in each round, so
+    // prefer asynchronous workers when evaluation time varies
+
+    const rng::Stream stream(seed);
+    std::vector<double> theta(ndims());
+    std::vector<double> phi(nderived());
+    timing::Stats local;
+
+    for (int i = mpi::get_rank(); i < nsamples; i += mpi::get_size()) {
+      for (int j = 0; j < theta.size(); j++) {
+        theta[j] = stream.uniform(i * theta.size() + j);
+      }
+      const timing::Timer timer;
+      loglike(model, gq, seed, theta.data(), theta.size(), phi.data(),
+              phi.size());
+      local.add(timer.elapsed());
+    }
+
+    loglike_timing = local.allreduce();
+    synchronous_threshold = threshold;
+    settings.synchronous = loglike_timing->cv() < threshold;
+  }
+
   void run() const {
     std::filesystem::create_directory(settings.base_dir);
 
@@ -180,33 +283,364 @@ class Model {
                                         / "clusters");
     }
 
+    // files written locally are copied back while sampling and once done
+
+    static std::filesystem::path base_dir_;
+    static std::vector<std::filesystem::path> staging_dirs_;
+
+    std::optional<stage::Stager> stager;
+    if (!stage_dir.empty()) {
+      base_dir_ = std::filesystem::weakly_canonical(settings.base_dir);
+      flush_stale_staging_dirs(base_dir_);
+
+      // e.g., resume files are flushed on every node before any is staged in
+      mpi::barrier();
+      stager.emplace(staging_dir(), base_dir_, stage_interval);
+      if (settings.do_clustering) {
+        std::filesystem::create_directory(
+            std::filesystem::path(staging_dir()) / "clusters");
+      }
+
+      // PolyChord reads only the resume file, on the root process of a
+      // replicate, and restores the rest of the run from it
+
+      if (settings.read_resume && mpi::get_rank() < ngroups()) {
+        for (int k = mpi::get_rank(); k < replicates; k += ngroups()) {
+          const std::filesystem::path path
+              = base_dir_ / (replicate_settings(k).file_root + ".resume");
+          if (std::filesystem::exists(path)) {
+            stager->stage_in(path);
+          }
+        }
+      }
+
+      // directories of the other processes, which are removed by whichever
+      // process aborts the run, if it can see them
+
+      const std::vector<int> pids
+          = mpi::allgather(std::vector<int>{::getpid()});
+      staging_dirs_.clear();
+      for (int rank = 0; rank < pids.size(); rank++) {
+        if (rank != mpi::get_rank()) {
+          staging_dirs_.push_back(staging_dir(rank, pids[rank]));
+        }
+      }
+    }
+
     static const bs_model* model_(model);
-    static bs_rng* rng_(rng);
+    static const bool gq_(gq);
+    static const unsigned int seed_(seed);
+    static timing::Counter* counter_(&counter);
+    static monitor::Monitor* monitor_ = nullptr;
+    static pipeline::Worker* worker_ = nullptr;
+    static async::Writer* progress_ = nullptr;
+    static stage::Stager* stager_ = nullptr;
+    stager_ = stager.has_value() ? &stager.value() : nullptr;
 
     const auto this_loglike
         = [](double* theta, int ndim, double* phi, int nderived) {
-            return loglike(model_, rng_, theta, ndim, phi, nderived);
+            const timing::Timer timer;
+            const double result
+                = loglike(model_, gq_, seed_, theta, ndim, phi, nderived);
+            counter_->n += 1;
+            counter_->busy += timer.elapsed();
+            return result;
           };
 
+    // called by PolyChord on the root process of a run with its dead points
+
+    const auto this_dumper
+        = [](int ndead, int nlive, int npars, double* live, double* dead,
+             double* logweights, double logz, double logzerr) {
+            // a monitor shares the online insertion indexes of a capture
+
+            if (monitor_ != nullptr) {
+              monitor_->update(ndead, npars, dead);
+            }
+
+            if (worker_ != nullptr) {
+              const std::vector<int> indexes = monitor_ != nullptr
+                                                   ? monitor_->latest()
+                                                   : std::vector<int>();
+              worker_->push(ndead, nlive, npars, live, dead, logz, logzerr,
+                            indexes);
+            }
+
+            if (monitor_ == nullptr) {
+              return;
+            }
+
+            if (monitor_->abort()) {
+              if (progress_ != nullptr) {
+                progress_->close();
+              }
+              if (stager_ != nullptr) {
+                stager_->finish();
+                for (const auto& dir : staging_dirs_) {
+                  stage::flush(dir, base_dir_);
+                }
+              }
+              std::cerr << monitor_->report() << "\nAborting as insertion "
+                        << "indexes are not uniform" << std::endl;
+              mpi::abort(ABORT_CODE);
+            }
+
+            if (progress_ != nullptr) {
+              progress_->write(monitor_->report() + "\n");
+              progress_->flush();
+            }
+          };
+
+    // replicates run concurrently on groups of processes, and sequentially
+    // within a group if there are more replicates than processes
+
+    const int group = mpi::get_rank() % ngroups();
+    const timing::Timer wall;
+
 #ifdef USE_MPI
-    run_polychord(this_loglike, settings, mpi::get_comm());
+    MPI_Comm comm = ngroups() > 1 ? mpi::split(group) : mpi::get_comm();
+#endif
+
+    for (int k = group; k < replicates; k += ngroups()) {
+      std::optional<monitor::Monitor> monitor;
+      if (monitor_options.enabled()) {
+        monitor.emplace(monitor_options, settings.nlive, batch,
+                        in_memory ? &captures[k].online : nullptr);
+        monitor_ = &monitor.value();
+      }
+
+      // progress is logged without waiting on the terminal or filesystem
+
+      std::optional<async::Writer> progress;
+      if (monitor_options.log) {
+        std::cout.flush();
+        progress.emplace(STDOUT_FILENO);
+        progress_ = &progress.value();
+      }
+
+      // captured points are processed in the background while sampling
+
+      std::optional<pipeline::Worker> worker;
+      if (in_memory) {
+        worker.emplace(captures[k]);
+        worker_ = &worker.value();
+      }
+
+#ifdef USE_MPI
+      run_polychord(this_loglike, this_dumper, polychord_settings(k), comm);
 #else
-    run_polychord(this_loglike, settings);
+      run_polychord(this_loglike, this_dumper, polychord_settings(k));
 #endif
+
+      if (in_memory) {
+        worker->finish();
+        captures[k].finish();
+      }
+
+      if (progress.has_value()) {
+        progress->close();
+      }
+
+      monitor_ = nullptr;
+      worker_ = nullptr;
+      progress_ = nullptr;
+    }
+
+    counter.wall = wall.elapsed();
+
+#ifdef USE_MPI
+    mpi::free(comm);
+#endif
+
+    // every file is in the base directory before any process reads it
+
+    if (stager.has_value()) {
+      stager->finish();
+      stager_ = nullptr;
+    }
+
+    mpi::barrier();
+  }
+
+  timing::LoadBalance load_balance() const {
+    // gathered on rank zero. masters dispatch work when there is more than
+    // one process per replicate
+
+    const bool master
+        = mpi::get_size() > ngroups() && mpi::get_rank() < ngroups();
+
+    timing::LoadBalance load_balance_;
+    load_balance_.neval = mpi::gather(std::vector<std::int64_t>{counter.n});
+    load_balance_.busy = mpi::gather(std::vector<double>{counter.busy});
+    load_balance_.wall = mpi::gather(std::vector<double>{counter.wall});
+    load_balance_.master = mpi::gather(std::vector<int>{master});
+    return load_balance_;
+  }
+
+  Settings replicate_settings(int k) const {
+    if (replicates == 1) {
+      return settings;
+    }
+
+    Settings replicate(settings);
+    replicate.file_root += "_" + std::to_string(k);
+
+    if (replicate.seed >= 0) {
+      replicate.seed += k;
+    }
+
+    return replicate;
+  }
+
+  std::string staging_dir(int rank = mpi::get_rank(),
+                          int pid = ::getpid()) const {
+    // local to a process, as processes may share a node
+    return std::filesystem::path(stage_dir)
+           / ("polystan_" + settings.file_root + "_" + std::to_string(rank)
+              + "_" + std::to_string(pid));
+  }
+
+  void flush_stale_staging_dirs(const std::filesystem::path& base_dir) const {
+    // left on this node by aborted runs of processes that no longer exist.
+    // files written since they were last synced, e.g., resume files, are
+    // copied to the base directory before the directory is removed
+
+    const std::string prefix = "polystan_" + settings.file_root + "_";
+    const auto digits = [](const std::string& field) {
+      return !field.empty()
+             && std::all_of(field.begin(), field.end(), ::isdigit);
+    };
+
+    try {
+      for (const auto& entry : std::filesystem::directory_iterator(stage_dir)) {
+        const std::string name = entry.path().filename();
+        if (!entry.is_directory()
+            || name.compare(0, prefix.size(), prefix) != 0) {
+          continue;
+        }
+
+        // rank and pid
+        const std::string rest = name.substr(prefix.size());
+        const auto split = rest.find('_');
+        if (split == std::string::npos || !digits(rest.substr(0, split))
+            || !digits(rest.substr(split + 1))) {
+          continue;
+        }
+
+        if (!stage::alive(std::stoi(rest.substr(split + 1)))) {
+          stage::flush(entry.path(), base_dir);
+        }
+      }
+    } catch (...) {
+      // e.g., removed by another process meanwhile
+    }
   }
 
-  void write(const std::string& json_file_name,
-             const std::string& toml_file_name) const {
+  Settings polychord_settings(int k) const {
+    // PolyChord writes nothing if results are captured in memory
+
+    Settings polychord = replicate_settings(k);
+
+    if (!stage_dir.empty()) {
+      polychord.base_dir = staging_dir();
+    }
+
+    if (in_memory) {
+      polychord.write_resume = false;
+      polychord.write_paramnames = false;
+      polychord.write_stats = false;
+      polychord.write_live = false;
+      polychord.write_dead = false;
+      polychord.write_prior = false;
+      polychord.posteriors = false;
+      polychord.equals = false;
+      polychord.cluster_posteriors = false;
+    }
+
+    return polychord;
+  }
+
+  async::Report write(const Output& output) const {
+    // post-processing is shared by all processes; rank zero writes results
+    // and reports what its writer threads did
+
+    const Results& results_now = results();
+    const auto& ess_ = results_now.ess;
+    const auto& p_value_ = results_now.p_value;
+    const auto& evidence_ = results_now.evidence;
+    const auto& replicate_evidences_ = results_now.replicate_evidences;
+    const auto& neval_ = results_now.neval;
+    const auto& load_balance_ = results_now.load_balance;
+    thin::Counts posterior_counts;
+    thin::Counts prior_counts;
+    std::optional<std::vector<read::Samples>> posterior_samples_;
+    std::optional<std::vector<read::Samples>> prior_samples_;
+    if (!output.no_samples) {
+      posterior_samples_ = posterior_samples(output.thinning, posterior_counts);
+      prior_samples_ = prior_samples(output.thinning, prior_counts);
+    }
+    std::int64_t posterior_unique = 0;
+    if (output.deduplicate && posterior_samples_.has_value()) {
+      for (auto& part : posterior_samples_.value()) {
+        auto multiplicity = part.deduplicate();
+        posterior_unique += multiplicity.size();
+        part.push_back(std::move(multiplicity));
+      }
+      posterior_unique = mpi::sum(posterior_unique);
+    }
+    std::vector<std::array<int, 2>> pairs;
+    for (const auto& [x, y] : output.histogram_pairs) {
+      pairs.push_back({index(x), index(y)});
+    }
+    auto [summary_stats_, sketches_, histograms_] = summaries(output, pairs);
+
+    const auto& sample_variables
+        = output.flat ? flat_variables() : variables();
+
+    // multiplicities follow the other columns of deduplicated samples
+    auto posterior_variables = sample_variables;
+    if (output.deduplicate) {
+      posterior_variables.push_back(
+          variables::scalar("multiplicity", names().size() + 1));
+    }
+
+    if (!mpi::is_rank_zero()) {
+      // take part in gathering samples in the same order as rank zero
+      write_samples(nullptr, nullptr, nullptr, "posterior", posterior_samples_,
+                    posterior_variables, "");
+      write_samples(nullptr, nullptr, nullptr, "prior", prior_samples_,
+                    sample_variables, "");
+      return async::Report();
+    }
+
     // polystan metadata
 
     json::Object polystan;
 
     polystan.add("stan file name", stan_file_name);
     polystan.add("stan data file", data_file_name);
-    polystan.add("polystan toml file", toml_file_name);
+    polystan.add("polystan toml file", output.toml_file_name);
     polystan.add("stan build info", stan_build_info());
     polystan.add("seed", seed);
 
+    json::Object parallelisation;
+    parallelisation.add("synchronous", settings.synchronous);
+
+    if (loglike_timing.has_value()) {
+      parallelisation.add("metadata",
+                          "Workers chosen from coefficient of variation of "
+                          "likelihood evaluation time at prior draws");
+      parallelisation.add("timed evaluations", loglike_timing->count());
+      parallelisation.add("mean evaluation time / s", loglike_timing->mean());
+      parallelisation.add("sd evaluation time / s", loglike_timing->sd());
+      parallelisation.add("coefficient of variation", loglike_timing->cv());
+      parallelisation.add("threshold", synchronous_threshold);
+    } else {
+      parallelisation.add("metadata", "Workers chosen by user");
+    }
+
+    polystan.add("parallelisation", parallelisation);
+
     // polychord metadata
 
     json::Object polychord;
@@ -215,6 +649,8 @@ class Model {
     polychord.add("num_repeats", settings.num_repeats);
     polychord.add("precision_criterion", settings.precision_criterion);
     polychord.add("seed", settings.seed);
+    polychord.add("replicates", replicates);
+    polychord.add("effective nlive", replicates * settings.nlive);
 
     // metadata format
 
@@ -237,10 +673,12 @@ class Model {
     // effective sample size
 
     json::Object ess_entry;
-    const auto ess_ = ess();
 
     if (ess_.has_value()) {
-      ess_entry.add("metadata", "Estimate of effective sample size");
+      ess_entry.add("metadata",
+                    "Kish estimate of effective sample size from weights of "
+                    "dead points, or number of equally weighted samples if "
+                    "dead points were not written");
       ess_entry.add("n", ess_.value());
     } else {
       ess_entry.add("metadata", "Did not write weighted samples file");
@@ -249,7 +687,6 @@ class Model {
     // test
 
     json::Object test;
-    const auto p_value_ = p_value();
 
     if (p_value_.has_value()) {
       test.add(
@@ -264,7 +701,6 @@ class Model {
     // evidence
 
     json::Object evidence_entry;
-    const auto evidence_ = evidence();
 
     if (evidence_.has_value()) {
       const auto [logz, err] = evidence_.value();
@@ -272,14 +708,21 @@ class Model {
                          "The evidence is log-normally distributed");
       evidence_entry.add("log evidence", logz);
       evidence_entry.add("error log evidence", err);
+    } else if (replicates > 1) {
+      evidence_entry.add("metadata", "Did not write dead points file");
     } else {
       evidence_entry.add("metadata", "Did not write stats file");
     }
 
+    if (replicate_evidences_.has_value()) {
+      const auto [logz, err] = replicate_evidences_.value();
+      evidence_entry.add("replicate log evidences", logz);
+      evidence_entry.add("replicate error log evidences", err);
+    }
+
     // evaluations
 
     json::Object neval_entry;
-    const auto neval_ = neval();
 
     if (neval_.has_value()) {
       neval_entry.add("metadata", "Total number of likelihood evaluations");
@@ -288,6 +731,47 @@ class Model {
       neval_entry.add("metadata", "Did not write stats file");
     }
 
+    // load balance
+
+    json::Object load_balance_entry;
+    load_balance_entry.add(
+        "metadata",
+        "Per process likelihood evaluations, time in likelihood (busy) and "
+        "time running PolyChord (wall). Efficiency is total busy over total "
+        "wall time. Imbalance is maximum over mean busy time of workers, "
+        "minus one. Master saturation is the smallest idle fraction of any "
+        "worker; if large, workers are waiting on the master. It is left "
+        "out if there is no master");
+    load_balance_entry.add("neval", load_balance_.neval);
+    load_balance_entry.add("busy / s", load_balance_.busy);
+    load_balance_entry.add("wall / s", load_balance_.wall);
+    load_balance_entry.add("master", load_balance_.master);
+    load_balance_entry.add("efficiency", load_balance_.efficiency());
+    load_balance_entry.add("imbalance", load_balance_.imbalance());
+    load_balance_entry.add("worker idle fraction", load_balance_.idle());
+    const auto saturation = load_balance_.master_saturation();
+    if (saturation.has_value()) {
+      load_balance_entry.add("master saturation", saturation.value());
+    }
+
+    // samples available and written after thinning
+
+    json::Object samples_entry;
+    samples_entry.add(
+        "metadata",
+        "Number of equally weighted samples available and written, after "
+        "systematic subsampling by output --thin and --max-samples, and of "
+        "unique posterior samples written by output --deduplicate");
+    samples_entry.add("thin", output.thinning.factor);
+    samples_entry.add("max samples", output.thinning.max_samples);
+    samples_entry.add("posterior available", posterior_counts.available);
+    samples_entry.add("posterior written", posterior_counts.kept);
+    samples_entry.add("prior available", prior_counts.available);
+    samples_entry.add("prior written", prior_counts.kept);
+    if (output.deduplicate) {
+      samples_entry.add("posterior unique", posterior_unique);
+    }
+
     // add samples stats data
 
     json::Object sample_stats;
@@ -295,42 +779,388 @@ class Model {
     sample_stats.add("ess", ess_entry);
     sample_stats.add("evidence", evidence_entry);
     sample_stats.add("neval", neval_entry);
+    sample_stats.add("load balance", load_balance_entry);
+    sample_stats.add("samples", samples_entry);
 
-    // samples
+    // write to disk, streaming samples column by column
 
-    auto names_ = names();
-    names_.insert(names_.begin(), "log-likelihood");
+    std::optional<npy::Bundle> bundle;
+    if (!output.npy_dir.empty()) {
+      bundle.emplace(output.npy_dir);
+    }
+    npy::Bundle* bundle_ptr = bundle.has_value() ? &bundle.value() : nullptr;
 
-    json::Object posterior_entry;
-    const auto posterior_samples_ = posterior_samples();
+    std::optional<zarr::Store> store;
+    if (!output.zarr_dir.empty()) {
+      store.emplace(output.zarr_dir, output.zarr_chunk_size, metadata,
+                    output.compress);
+      store->group("sample_stats", sample_stats);
+    }
+    zarr::Store* store_ptr = store.has_value() ? &store.value() : nullptr;
+
+    json::Stream stream(output.json_file_name, output.format,
+                        output.compress);
+    stream.start_object();
+    stream.add("posterior_attrs", metadata);
+    stream.add("prior_attrs", metadata);
+    stream.add("sample_stats_attrs", metadata);
+    stream.add("sample_stats", sample_stats);
+    if (output.summary) {
+      json::Object summary_;
+      if (summary_stats_.has_value()) {
+        summary::add(summary_, sample_variables, summary_stats_.value());
+      } else {
+        summary_.add("metadata",
+                     "Did not compute summary as dead points were not "
+                     "written");
+      }
+      stream.add("summary", summary_);
+    }
+    if (output.sketch) {
+      // sketches are found for the summary and histograms too
+      json::Object quantiles;
+      if (sketches_.has_value()) {
+        for (const auto& variable : sample_variables) {
+          if (variable.begin == 0) {
+            continue;
+          }
+          json::Object entry;
+          for (const double q : output.quantiles) {
+            auto quantile = variables::arrange(variable, [&](int column) {
+              return sketches_.value()[column - 1].quantile(q);
+            });
+            entry.add(summary::percent(q), quantile, variable.shape);
+          }
+          quantiles.add(variable.name, entry);
+        }
+      } else {
+        quantiles.add("metadata",
+                      "Did not compute quantiles as dead points were not "
+                      "written");
+      }
+      stream.add("quantiles", quantiles);
+    }
+    if (output.histogram_bins > 0) {
+      json::Object histogram_entry;
+      if (histograms_.has_value()) {
+        json::Object marginals;
+        for (const auto& variable : sample_variables) {
+          if (variable.begin == 0) {
+            continue;
+          }
+          auto entries = variables::arrange(variable, [&](int column) {
+            return histograms_.value()[column - 1].to_object();
+          });
+          marginals.add(variable.name, entries, variable.shape);
+        }
+        json::Object joint;
+        for (int k = 0; k < pairs.size(); k++) {
+          const auto& [x, y] = output.histogram_pairs[k];
+          histograms_.value()[names().size() + k].add_to(joint, x + ":" + y);
+        }
+        histogram_entry.add("marginals", marginals);
+        histogram_entry.add("pairs", joint);
+      } else {
+        histogram_entry.add("metadata",
+                            "Did not compute histograms as dead points were "
+                            "not written");
+      }
+      stream.add("histograms", histogram_entry);
+    }
+    write_samples(&stream, bundle_ptr, store_ptr, "posterior",
+                  posterior_samples_, posterior_variables,
+                  output.no_samples
+                      ? "Did not load samples as output --no-samples"
+                      : "Did not write equally weighted posterior points");
+    write_samples(&stream, bundle_ptr, store_ptr, "prior", prior_samples_,
+                  sample_variables,
+                  output.no_samples
+                      ? "Did not load samples as output --no-samples"
+                      : "Did not write equally weighted prior points");
+    stream.end_object();
+    async::Report report = stream.close();
+
+    if (bundle.has_value()) {
+      report += bundle->write_manifest(metadata, sample_stats);
+    }
 
-    if (posterior_samples_.has_value()) {
-      posterior_entry.add(names_, posterior_samples_.value());
-    } else {
-      posterior_entry.add("metadata",
-                          "Did not write equally weighted posterior points");
+    if (store.has_value()) {
+      report += store->close();
     }
 
-    json::Object prior_entry;
-    const auto prior_samples_ = prior_samples();
+    // metadata was built in the process-wide pool
 
-    if (prior_samples_.has_value()) {
-      prior_entry.add(names_, prior_samples_.value());
-    } else {
-      prior_entry.add("metadata",
-                      "Did not write equally weighted prior points");
+    json::get_allocator().Clear();
+    return report;
+  }
+
+  void compress(int level) const {
+    // replace PolyChord's text files by gzip copies once every process has
+    // read them. files are shared among processes and then threads
+
+    const std::vector<std::string> suffixes{
+        ".txt", "_dead.txt", "_dead-birth.txt", "_equal_weights.txt",
+        "_prior.txt"};
+    std::vector<std::string> names_;
+
+    for (const auto& suffix : suffixes) {
+      for (const auto& file_name : file_names(suffix)) {
+        if (std::filesystem::exists(file_name)) {
+          names_.push_back(file_name);
+        }
+      }
+    }
+
+    mpi::barrier();
+
+    std::vector<std::string> local;
+    for (int i = mpi::get_rank(); i < names_.size(); i += mpi::get_size()) {
+      local.push_back(names_[i]);
     }
 
-    // write to disk
+    const int nthreads = std::min<int>(read_threads(), local.size());
+    read::parallel(nthreads, [&](int t) {
+      for (int i = t; i < local.size(); i += nthreads) {
+        gzip::compress_file(local[i], level);
+      }
+    });
+
+    mpi::barrier();
+  }
+
+  static bool polychord_file(const std::string& name, const std::string& root,
+                             bool cluster) {
+    // whether name is one that PolyChord writes for root, e.g., root.stats,
+    // or, in clusters, root_1.txt, or a gzip copy of one
+
+    static const std::vector<std::string> suffixes{
+        ".stats",        ".resume",         ".txt",
+        "_dead.txt",     "_dead-birth.txt", "_equal_weights.txt",
+        "_prior.txt",    ".paramnames",     "_phys_live.txt",
+        "_phys_live-birth.txt"};
+    static const std::vector<std::string> cluster_suffixes{
+        ".txt", "_dead.txt", "_dead-birth.txt", "_equal_weights.txt",
+        "_phys_live.txt", "_phys_live-birth.txt"};
+
+    if (name.compare(0, root.size(), root) != 0) {
+      return false;
+    }
+
+    std::string rest = name.substr(root.size());
+    if (gzip::has_suffix(rest)) {
+      rest.resize(rest.size() - std::string(gzip::SUFFIX).size());
+    }
+
+    if (!cluster) {
+      return std::find(suffixes.begin(), suffixes.end(), rest)
+             != suffixes.end();
+    }
+
+    // cluster number
+
+    if (rest.size() < 2 || rest[0] != '_' || !std::isdigit(rest[1])) {
+      return false;
+    }
+    rest.erase(0, 1);
+    while (!rest.empty() && std::isdigit(rest[0])) {
+      rest.erase(0, 1);
+    }
+
+    return std::find(cluster_suffixes.begin(), cluster_suffixes.end(), rest)
+           != cluster_suffixes.end();
+  }
+
+  std::vector<std::filesystem::path> run_files(
+      const std::filesystem::path& dir) const {
+    // PolyChord's files for the replicates of this run in a directory and
+    // its clusters subdirectory, but not those of other runs there
+
+    std::vector<std::string> roots;
+    for (int k = 0; k < replicates; k++) {
+      roots.push_back(replicate_settings(k).file_root);
+    }
+
+    std::vector<std::filesystem::path> paths;
+
+    for (const bool cluster : {false, true}) {
+      const std::filesystem::path dir_ = cluster ? dir / "clusters" : dir;
+      if (!std::filesystem::is_directory(dir_)) {
+        continue;
+      }
+      for (const auto& entry : std::filesystem::directory_iterator(dir_)) {
+        const std::string name = entry.path().filename();
+        if (entry.is_regular_file()
+            && std::any_of(roots.begin(), roots.end(), [&](const auto& root) {
+                 return polychord_file(name, root, cluster);
+               })) {
+          paths.push_back(entry.path());
+        }
+      }
+    }
+
+    return paths;
+  }
+
+  std::string archive(const std::string& archive_file_name,
+                      const std::vector<std::string>& others) const {
+    // pack PolyChord's files for this run and other files, e.g., the JSON
+    // and TOML files, into one archive on rank zero and remove them, except
+    // resume files, so that the run can still be resumed. returns the
+    // archive path of the first of the other files
+
+    mpi::barrier();
+
+    const std::filesystem::path base_dir
+        = std::filesystem::weakly_canonical(settings.base_dir);
+    const std::filesystem::path archive_path
+        = std::filesystem::weakly_canonical(archive_file_name);
+
+    std::vector<std::pair<std::string, std::string>> members;
+
+    for (const auto& path : run_files(base_dir)) {
+      if (path != archive_path) {
+        members.emplace_back(path, path.lexically_relative(base_dir));
+      }
+    }
+
+    for (const auto& file_name : others) {
+      if (std::filesystem::exists(file_name)) {
+        members.emplace_back(file_name,
+                             std::filesystem::path(file_name).filename());
+      }
+    }
+
+    if (mpi::is_rank_zero()) {
+      archive::Writer writer(archive_file_name);
+      for (const auto& [file_name, member] : members) {
+        writer.add(file_name, member);
+      }
+      writer.close();
+
+      for (const auto& [file_name, member] : members) {
+        if (std::filesystem::path(file_name).extension() != ".resume") {
+          std::filesystem::remove(file_name);
+        }
+      }
+
+      // only removed if empty
+      std::error_code error;
+      std::filesystem::remove(base_dir / "clusters", error);
+      std::filesystem::remove(base_dir, error);
+    }
+
+    mpi::barrier();
+
+    if (others.empty()) {
+      return archive_file_name;
+    }
+
+    return archive_file_name + "/"
+           + std::filesystem::path(others[0]).filename().string();
+  }
+
+  void write_samples(json::Stream* stream, npy::Bundle* bundle,
+                     zarr::Store* store, const std::string& name,
+                     std::optional<std::vector<read::Samples>>& parts,
+                     const std::vector<variables::Variable>& sample_variables,
+                     const std::string& missing) const {
+    // gather one variable at a time on rank zero, which alone has a stream,
+    // releasing local memory as we go. arrays are written to JSON as one
+    // nested array per variable with a leading chain dimension, and to npy
+    // files and Zarr arrays in C order with leading chain and draw dimensions
+
+    if (!parts.has_value()) {
+      if (stream != nullptr) {
+        stream->key(name);
+        stream->start_object();
+        stream->add("metadata", missing);
+        stream->end_object();
+      }
+      if (bundle != nullptr) {
+        bundle->missing(name, missing);
+      }
+      if (store != nullptr) {
+        store->missing(name, missing);
+      }
+      return;
+    }
+
+    if (stream != nullptr) {
+      stream->key(name);
+      stream->start_object();
+    }
+
+    if (store != nullptr) {
+      store->group(name);
+    }
+
+    const bool whole_columns = bundle != nullptr || store != nullptr;
+
+    for (const auto& variable : sample_variables) {
+      const bool scalar = variable.shape.empty();
 
-    json::Object document;
-    document.copy("posterior_attrs", metadata);
-    document.copy("prior_attrs", metadata);
-    document.add("sample_stats_attrs", metadata);
-    document.add("sample_stats", sample_stats);
-    document.add("posterior", posterior_entry);
-    document.add("prior", prior_entry);
-    document.write(json_file_name);
+      if (stream != nullptr) {
+        stream->key(variable.name);
+        stream->start_array();
+        if (!scalar) {
+          stream->start_array();
+        }
+      }
+
+      std::vector<double> whole;
+
+      for (auto& part : parts.value()) {
+        std::vector<std::vector<double>> columns(variable.size());
+        for (int k = 0; k < variable.size(); k++) {
+          columns[k] = mpi::gather(part.take(variable.begin + k));
+        }
+
+        if (stream != nullptr && scalar) {
+          stream->values(columns[0]);
+        } else if (stream != nullptr) {
+          std::vector<double> draw(variable.size());
+          for (int j = 0; j < columns[0].size(); j++) {
+            for (int k = 0; k < variable.size(); k++) {
+              draw[variable.offsets[k]] = columns[k][j];
+            }
+            stream->array(draw.data(), variable.shape);
+          }
+        }
+
+        if (whole_columns) {
+          const std::size_t start = whole.size();
+          whole.resize(start + columns[0].size() * variable.size());
+          for (int j = 0; j < columns[0].size(); j++) {
+            for (int k = 0; k < variable.size(); k++) {
+              whole[start + j * variable.size() + variable.offsets[k]]
+                  = columns[k][j];
+            }
+          }
+        }
+      }
+
+      if (stream != nullptr) {
+        if (!scalar) {
+          stream->end_array();
+        }
+        stream->end_array();
+      }
+
+      if (bundle != nullptr) {
+        bundle->add(name, variable.name, whole, variable.shape);
+      }
+
+      if (store != nullptr) {
+        if (variable.begin == 0) {
+          store->coordinates(name, whole.size() / variable.size());
+        }
+        store->add(name, variable.name, whole, variable.shape);
+      }
+    }
+
+    if (stream != nullptr) {
+      stream->end_object();
+    }
   }
 
   const std::string data_file_name;
@@ -347,6 +1177,27 @@ class Model {
     return read::param_names(bs_param_names(model, derived, derived));
   }
 
+  const std::vector<variables::Variable>& variables() const {
+    // columns of samples, i.e., log-likelihood and then parameters, grouped
+    // into arrays. parsed once
+
+    if (!variables_.has_value()) {
+      auto names_ = names();
+      names_.insert(names_.begin(), "log-likelihood");
+      variables_ = variables::parse(names_);
+    }
+    return variables_.value();
+  }
+
+  const std::vector<variables::Variable>& flat_variables() const {
+    if (!flat_variables_.has_value()) {
+      auto names_ = names();
+      names_.insert(names_.begin(), "log-likelihood");
+      flat_variables_ = variables::parse(names_, true);
+    }
+    return flat_variables_.value();
+  }
+
   std::vector<std::string> param_names() const {
     std::vector<std::string> names_ = names();
     return std::vector<std::string>(names_.begin(), names_.begin() + ndims());
@@ -368,63 +1219,691 @@ class Model {
 
   std::string name() const { return bs_name(model); }
 
+  int index(const std::string& name) const {
+    // of a parameter, or -1 if there is no such parameter
+
+    const auto names_ = names();
+    const auto it = std::find(names_.begin(), names_.end(), name);
+    return it == names_.end() ? -1 : it - names_.begin();
+  }
+
   std::string basename() const {
     return std::filesystem::weakly_canonical(settings.base_dir)
            / settings.file_root;
   }
 
-  std::optional<std::vector<std::vector<double>>> posterior_samples() const {
+  std::vector<std::string> file_names(const std::string& suffix) const {
+    // one file per replicate
+
+    const std::filesystem::path base_dir
+        = std::filesystem::weakly_canonical(settings.base_dir);
+    std::vector<std::string> names_;
+
+    for (int k = 0; k < replicates; k++) {
+      names_.push_back(base_dir / (replicate_settings(k).file_root + suffix));
+    }
+
+    return names_;
+  }
+
+  std::vector<read::Samples> samples(
+      const std::vector<std::string>& file_names_,
+      const thin::Options& thinning, thin::Counts& counts) const {
+    // each process maps part of each file, keeping rows that are not thinned
+    // out. columns are parsed and gathered on rank zero one variable at a
+    // time while writing
+
+    std::vector<read::Samples> parts;
+
+    for (int k = 0; k < file_names_.size(); k++) {
+      read::Samples part(
+          file_names_[k], mpi::get_rank(), mpi::get_size(), read_threads(),
+          [&](std::size_t n) {
+            return select(n, k, file_names_.size(), thinning, counts);
+          });
+      part.resize(names().size() + 1);
+      parts.push_back(std::move(part));
+    }
+
+    return parts;
+  }
+
+  std::vector<std::int64_t> select(std::size_t n, int k, int nparts,
+                                   const thin::Options& thinning,
+                                   thin::Counts& counts) const {
+    // rows to keep of the n in this process's share of part k, where the
+    // shares of all processes follow each other in rank order
+
+    const auto sizes
+        = mpi::allgather(std::vector<std::int64_t>{std::int64_t(n)});
+    const std::int64_t total
+        = std::accumulate(sizes.begin(), sizes.end(), std::int64_t(0));
+    const std::int64_t begin = std::accumulate(
+        sizes.begin(), sizes.begin() + mpi::get_rank(), std::int64_t(0));
+    const std::int64_t keep = thinning.keep(total, k, nparts);
+
+    counts.available += total;
+    counts.kept += keep;
+
+    auto rows = thin::systematic(total, keep, thin_offset(k), begin, begin + n);
+    for (auto& row : rows) {
+      row -= begin;
+    }
+    return rows;
+  }
+
+  void subsample(read::Columns& part, int k, int nparts,
+                 const thin::Options& thinning, thin::Counts& counts) const {
+    const std::size_t n = part.empty() ? 0 : part[0].size();
+    const auto rows = select(n, k, nparts, thinning, counts);
+
+    if (rows.size() == n) {
+      return;
+    }
+
+    for (auto& column : part) {
+      for (std::size_t i = 0; i < rows.size(); i++) {
+        column[i] = column[rows[i]];
+      }
+      column.resize(rows.size());
+      column.shrink_to_fit();
+    }
+  }
+
+  double thin_offset(int k) const {
+    // random start of systematic subsampling of part k
+    const rng::Stream stream(rng::mix(rng::mix(seed)));
+    return stream.uniform(k);
+  }
+
+  std::array<std::vector<double>, 2> death_birth(
+      const std::vector<std::string>& file_names_,
+      std::vector<std::array<std::int64_t, 2>>* rows = nullptr) const {
+    // each process parses part of each file and all processes gather them.
+    // rows, if given, are the ranges of the gathered rows of this process
+
+    std::array<std::vector<double>, 2> data;
+
+    for (const auto& file_name : file_names_) {
+      const auto part = read::death_birth(file_name, mpi::get_rank(),
+                                          mpi::get_size(), read_threads());
+
+      if (rows != nullptr) {
+        const auto sizes = mpi::allgather(
+            std::vector<std::int64_t>{std::int64_t(part[0].size())});
+        const std::int64_t begin
+            = data[0].size()
+              + std::accumulate(sizes.begin(), sizes.begin() + mpi::get_rank(),
+                                std::int64_t(0));
+        rows->push_back({begin, begin + std::int64_t(part[0].size())});
+      }
+
+      for (int i = 0; i < 2; i++) {
+        const auto column = mpi::allgather(part[i]);
+        data[i].insert(data[i].end(), column.begin(), column.end());
+      }
+    }
+
+    return data;
+  }
+
+  Summaries summaries(const Output& output,
+                      const std::vector<std::array<int, 2>>& pairs) const {
+    // summary statistics and quantile sketches from one pass over the dead
+    // points; histograms need another, as their ranges are found from the
+    // sketches. statistics are found on rank zero
+
+    Summaries summaries_;
+    const bool wanted
+        = output.summary || output.sketch || output.histogram_bins > 0;
+
+    if (!wanted || (!in_memory && !settings.write_dead)) {
+      return summaries_;
+    }
+
+    const int nparams = names().size();
+    std::vector<sketch::TDigest> sketches_(nparams);
+    std::vector<summary::Moments> moments(output.summary ? nparams : 0);
+
+    for_each_dead_block(
+        read_threads(), nparams,
+        [&](int begin, int end, const double* rows, std::size_t nrows) {
+          for (std::size_t i = 0; i < nrows; i++) {
+            const double* row = rows + i * (nparams + 1);
+            for (int j = begin; j < end; j++) {
+              sketches_[j].add(row[j], row[nparams]);
+            }
+            if (!moments.empty()) {
+              for (int j = begin; j < end; j++) {
+                moments[j].add(row[j], row[nparams]);
+              }
+            }
+          }
+        });
+
+    for (auto& sketch : sketches_) {
+      sketch.gather();
+    }
+
+    if (output.summary) {
+      std::vector<summary::Stats> stats;
+      for (int j = 0; j < nparams; j++) {
+        moments[j].gather();
+        if (mpi::is_rank_zero()) {
+          stats.push_back(moments[j].stats(sketches_[j]));
+        }
+      }
+      summaries_.stats = stats;
+    }
+
+    summaries_.sketches = std::move(sketches_);
+
+    if (output.histogram_bins > 0) {
+      summaries_.histograms
+          = histograms(output.histogram_bins, pairs, summaries_.sketches);
+    }
+
+    if (!output.sketch) {
+      summaries_.sketches.reset();
+    }
+
+    return summaries_;
+  }
+
+  template <typename F>
+  void for_each_dead_point(int nthreads, F f) const {
+    // call f(thread, parameters, weight) for every dead point, with weights
+    // of the merged run, on each thread of each process, as they are read
+
+    const int nparams = names().size();
+    const std::vector<double>& w = results().weights;
+
+    std::size_t offset = 0;
+
+    if (in_memory) {
+      for (const auto& run : captures) {
+        if (!run.held) {
+          continue;
+        }
+        const std::int64_t n = run.birth.size();
+        read::parallel(nthreads, [&](int t) {
+          std::vector<double> values(nparams);
+          for (std::int64_t i = t; i < n; i += nthreads) {
+            for (int j = 0; j < nparams; j++) {
+              values[j] = run.columns[j + 1][i];
+            }
+            f(t, values, w[offset + i]);
+          }
+        });
+        offset += n;
+      }
+      return;
+    }
+
+    for (const auto& file_name : file_names("_dead-birth.txt")) {
+      // rows of this part follow those of this process in earlier files
+
+      std::size_t start = 0;
+      read::for_each_row(
+          file_name, mpi::get_rank(), mpi::get_size(), nthreads,
+          [&](int t, std::size_t row, const std::vector<double>& values) {
+            f(t, values, w[start + row]);
+          },
+          [&](std::size_t n) {
+            start = offset;
+            offset += n;
+          });
+    }
+  }
+
+  template <typename F>
+  void for_each_dead_block(int nthreads, int nitems, F f) const {
+    // call f(begin, end, rows, nrows) for items begin to end, e.g., sketches
+    // of parameters, with rows of dead points each followed by its weight.
+    // threads buffer rows and visit blocks of items in turn, one thread in a
+    // block at a time, so that items are shared by threads rather than
+    // copied per thread, and memory doesn't grow with threads times items
+
+    const int nparams = names().size();
+    const int nblocks = std::max(1, std::min(nitems, 4 * nthreads));
+    const std::size_t row_size = nparams + 1;
+    const std::size_t capacity
+        = std::max<std::size_t>(1, (std::size_t(1) << 20) / row_size)
+          * row_size;
+
+    std::vector<std::mutex> locks(nblocks);
+    std::vector<std::vector<double>> buffers(nthreads);
+
+    const auto flush = [&](int t) {
+      std::vector<double>& buffer = buffers[t];
+      const std::size_t nrows = buffer.size() / row_size;
+      for (int k = 0; k < nblocks; k++) {
+        const int b = (t + k) % nblocks;
+        const std::lock_guard<std::mutex> lock(locks[b]);
+        f(nitems * b / nblocks, nitems * (b + 1) / nblocks, buffer.data(),
+          nrows);
+      }
+      buffer.clear();
+    };
+
+    for_each_dead_point(nthreads, [&](int t, const std::vector<double>& values,
+                                      double w) {
+      std::vector<double>& buffer = buffers[t];
+      if (buffer.capacity() < capacity) {
+        buffer.reserve(capacity);
+      }
+      buffer.insert(buffer.end(), values.begin(), values.end());
+      buffer.push_back(w);
+      if (buffer.size() >= capacity) {
+        flush(t);
+      }
+    });
+
+    for (int t = 0; t < nthreads; t++) {
+      flush(t);
+    }
+  }
+
+  std::optional<std::vector<histogram::Histogram>> histograms(
+      int bins, const std::vector<std::array<int, 2>>& pairs,
+      const std::optional<std::vector<sketch::TDigest>>& sketches_) const {
+    // marginal histograms of each parameter and then of each pair of
+    // parameters, from every dead point. the range of each parameter is
+    // found from its quantile sketch, so that it covers the posterior rather
+    // than the prior
+
+    if (!sketches_.has_value()) {
+      return std::nullopt;
+    }
+
+    const int nparams = names().size();
+    std::vector<histogram::Axis> axes;
+
+    for (int j = 0; j < nparams; j++) {
+      auto sketch = sketches_.value()[j];
+      double lower = mpi::broadcast(sketch.quantile(0.001));
+      double upper = mpi::broadcast(sketch.quantile(0.999));
+      if (!(upper > lower)) {
+        lower -= 0.5;
+        upper += 0.5;
+      }
+      axes.push_back({lower, upper, bins});
+    }
+
+    std::vector<histogram::Histogram> prototype;
+    for (const auto& axis : axes) {
+      prototype.emplace_back(std::vector<histogram::Axis>{axis});
+    }
+    for (const auto& [i, j] : pairs) {
+      prototype.emplace_back(std::vector<histogram::Axis>{axes[i], axes[j]});
+    }
+
+    // marginals and then pairs
+
+    std::vector<histogram::Histogram> local(std::move(prototype));
+
+    for_each_dead_block(
+        read_threads(), local.size(),
+        [&](int begin, int end, const double* rows, std::size_t nrows) {
+          std::vector<double> x;
+          for (std::size_t i = 0; i < nrows; i++) {
+            const double* row = rows + i * (nparams + 1);
+            for (int k = begin; k < end; k++) {
+              if (k < nparams) {
+                x.assign({row[k]});
+              } else {
+                x.assign({row[pairs[k - nparams][0]],
+                          row[pairs[k - nparams][1]]});
+              }
+              local[k].add(x, row[nparams]);
+            }
+          }
+        });
+
+    for (auto& histogram : local) {
+      histogram.gather();
+    }
+
+    return local;
+  }
+
+  std::optional<std::vector<read::Samples>> posterior_samples(
+      const thin::Options& thinning, thin::Counts& counts) const {
+    if (in_memory) {
+      return captured_posterior(thinning, counts);
+    }
     if (!settings.equals) {
       return std::nullopt;
     }
-    return read::samples(basename() + "_equal_weights.txt");
+    return samples(file_names("_equal_weights.txt"), thinning, counts);
   }
 
-  std::optional<std::vector<std::vector<double>>> prior_samples() const {
+  std::optional<std::vector<read::Samples>> prior_samples(
+      const thin::Options& thinning, thin::Counts& counts) const {
     if (!settings.write_prior) {
       return std::nullopt;
     }
-    return read::samples(basename() + "_prior.txt");
+    if (in_memory) {
+      return drawn_prior(thinning, counts);
+    }
+    return samples(file_names("_prior.txt"), thinning, counts);
   }
 
-  std::optional<std::array<double, 2>> evidence() const {
-    if (!settings.write_stats) {
-      return std::nullopt;
+  std::array<std::vector<double>, 2> captured_death_birth() const {
+    // all processes gather each replicate from the process that captured it
+
+    std::array<std::vector<double>, 2> data;
+
+    for (const auto& run : captures) {
+      const auto death = mpi::allgather(run.death());
+      const auto birth = mpi::allgather(run.birth);
+      data[0].insert(data[0].end(), death.begin(), death.end());
+      data[1].insert(data[1].end(), birth.begin(), birth.end());
     }
-    return read::evidence(basename() + ".stats");
+
+    return data;
   }
 
-  std::optional<double> p_value() const {
-    if (!settings.write_dead) {
-      return std::nullopt;
+  std::vector<read::Samples> captured_posterior(
+      const thin::Options& thinning, thin::Counts& counts) const {
+    // equally weighted samples by rejection of dead points, with weights of
+    // the merged run
+
+    const std::vector<double>& w = results().weights;
+    const double max_w = mpi::max(
+        w.empty() ? 0. : *std::max_element(w.begin(), w.end()));
+
+    std::vector<read::Samples> parts;
+    std::size_t offset = 0;
+
+    for (int k = 0; k < captures.size(); k++) {
+      const auto& run = captures[k];
+      read::Columns part(names().size() + 1);
+
+      if (run.held) {
+        const rng::Stream stream(rng::mix(seed) + k);
+
+        for (int i = 0; i < run.birth.size(); i++) {
+          if (stream.uniform(i) * max_w < w[offset + i]) {
+            for (int c = 0; c < part.size(); c++) {
+              part[c].push_back(run.columns[c][i]);
+            }
+          }
+        }
+      }
+
+      subsample(part, k, captures.size(), thinning, counts);
+      parts.emplace_back(std::move(part));
+      if (run.held) {
+        offset += run.birth.size();
+      }
     }
-    return test::insertion_index_p_value(basename() + "_dead-birth.txt",
-                                         settings.nlive, batch);
+
+    return parts;
   }
 
-  std::optional<int> ess() const {
-    if (!settings.write_stats) {
-      return std::nullopt;
+  std::vector<read::Samples> drawn_prior(const thin::Options& thinning,
+                                         thin::Counts& counts) const {
+    // prior draws made by PolyStan, as PolyChord's dumper isn't passed its
+    // prior phase. nprior are drawn per replicate, as written to files, and
+    // thinned per replicate. each process draws a share of those kept
+
+    const int nprior = settings.nprior > 0 ? settings.nprior : settings.nlive;
+    std::vector<std::int64_t> draws;
+
+    for (int k = 0; k < replicates; k++) {
+      const std::int64_t keep = thinning.keep(nprior, k, replicates);
+      for (std::int64_t i = 0; i < keep; i++) {
+        draws.push_back(std::int64_t(k) * nprior
+                        + thin::position(i, nprior, keep, thin_offset(k)));
+      }
+      counts.available += nprior;
+      counts.kept += keep;
     }
-    return read::ess(basename() + ".stats");
+
+    const std::int64_t begin = draws.size() * mpi::get_rank() / mpi::get_size();
+    const std::int64_t end
+        = draws.size() * (mpi::get_rank() + 1) / mpi::get_size();
+
+    const rng::Stream stream(seed);
+    std::vector<double> theta(ndims());
+    std::vector<double> phi(nderived());
+    read::Columns part(names().size() + 1);
+
+    for (std::int64_t k = begin; k < end; k++) {
+      const std::int64_t i = draws[k];
+      for (int j = 0; j < theta.size(); j++) {
+        theta[j] = stream.uniform(i * theta.size() + j);
+      }
+
+      part[0].push_back(loglike(model, gq, seed, theta.data(), theta.size(),
+                                phi.data(), phi.size()));
+
+      for (int j = 0; j < theta.size(); j++) {
+        part[j + 1].push_back(theta[j]);
+      }
+      for (int j = 0; j < phi.size(); j++) {
+        part[theta.size() + j + 1].push_back(phi[j]);
+      }
+    }
+
+    std::vector<read::Samples> parts;
+    parts.emplace_back(std::move(part));
+    return parts;
   }
 
-  std::optional<int> neval() const {
-    if (!settings.write_stats) {
-      return std::nullopt;
+  const Results& results() const {
+    // computed once, by all processes together, from the outputs of a run
+
+    if (!results_.has_value()) {
+      results_ = in_memory ? captured_results() : read_results();
     }
-    return read::neval(basename() + ".stats");
+
+    return results_.value();
   }
 
+  Results captured_results() const {
+    // weights from contours of the captured dead points
+
+    Results results_now;
+
+    auto [death, birth] = captured_death_birth();
+
+    if (!death.empty()) {
+      auto sorted_death = death;
+      auto sorted_birth = birth;
+      merge::sort_by_death(sorted_death, sorted_birth);
+      const auto log_w = merge::log_weights(sorted_death, sorted_birth);
+      results_now.ess = merge::ess(log_w);
+
+      if (replicates == 1) {
+        // PolyChord's own estimate, as in its stats file, passed to the
+        // dumper of the process that captured the run, i.e., rank zero
+        results_now.evidence
+            = std::array<double, 2>{mpi::broadcast(captures[0].evidence[0]),
+                                    mpi::broadcast(captures[0].evidence[1])};
+      } else {
+        results_now.evidence = merge::evidence(log_w, sorted_death,
+                                               replicates * settings.nlive);
+      }
+
+      // each process keeps the weights of the replicates it captured
+
+      const auto w = summary::weights(death, birth);
+      std::size_t offset = 0;
+      for (const auto& run : captures) {
+        const std::int64_t n = mpi::sum<std::int64_t>(run.birth.size());
+        if (run.held) {
+          results_now.weights.insert(results_now.weights.end(),
+                                     w.begin() + offset,
+                                     w.begin() + offset + n);
+        }
+        offset += n;
+      }
+
+      if (replicates == 1) {
+        // indexes were found while sampling by the process that captured
+        // the run, i.e., rank zero
+        const auto& run = captures[0];
+        const double p_value_
+            = run.held ? test::batched_p_value(run.indexes, run.birth,
+                                               settings.nlive, batch)
+                       : 0.;
+        results_now.p_value = mpi::broadcast(p_value_);
+      } else {
+        results_now.p_value = p_value(death, birth);
+      }
+    }
+
+    if (replicates > 1) {
+      // each replicate from the process that captured it
+
+      std::vector<double> local;
+      for (int k = 0; k < captures.size(); k++) {
+        if (captures[k].held) {
+          local.insert(local.end(), {static_cast<double>(k),
+                                     captures[k].evidence[0],
+                                     captures[k].evidence[1]});
+        }
+      }
+
+      const auto global = mpi::allgather(local);
+      std::array<std::vector<double>, 2> evidences;
+      evidences[0].resize(replicates);
+      evidences[1].resize(replicates);
+      for (int i = 0; i + 2 < global.size(); i += 3) {
+        const int k = global[i];
+        evidences[0][k] = global[i + 1];
+        evidences[1][k] = global[i + 2];
+      }
+      results_now.replicate_evidences = evidences;
+    }
+
+    results_now.neval = mpi::sum(counter.n);
+    results_now.load_balance = load_balance();
+
+    return results_now;
+  }
+
+  Results read_results() const {
+    // each file is read once
+
+    std::vector<read::Stats> stats;
+    if (settings.write_stats) {
+      for (const auto& stats_file_name : file_names(".stats")) {
+        stats.push_back(read::stats(stats_file_name));
+      }
+    }
+
+    std::optional<std::array<std::vector<double>, 2>> dead;
+    std::vector<std::array<std::int64_t, 2>> rows;
+    if (settings.write_dead) {
+      dead = death_birth(file_names("_dead-birth.txt"), &rows);
+    }
+
+    Results results_now;
+
+    // the effective sample size is from weights of dead points, as for runs
+    // captured in memory, and PolyChord's number of equally weighted samples
+    // only if dead points weren't written
+
+    if (dead.has_value()) {
+      auto [death, birth] = dead.value();
+      merge::sort_by_death(death, birth);
+      const auto log_w = merge::log_weights(death, birth);
+      results_now.ess = merge::ess(log_w);
+      if (replicates > 1) {
+        results_now.evidence
+            = merge::evidence(log_w, death, replicates * settings.nlive);
+      }
+    } else if (replicates == 1 && settings.write_stats) {
+      results_now.ess = stats[0].ess;
+    }
+
+    if (replicates == 1 && settings.write_stats) {
+      results_now.evidence = stats[0].evidence;
+    }
+
+    if (replicates > 1 && settings.write_stats) {
+      std::array<std::vector<double>, 2> evidences;
+      for (const auto& stats_ : stats) {
+        evidences[0].push_back(stats_.evidence[0]);
+        evidences[1].push_back(stats_.evidence[1]);
+      }
+      results_now.replicate_evidences = evidences;
+    }
+
+    if (settings.write_stats) {
+      int total = 0;
+      for (const auto& stats_ : stats) {
+        total += stats_.neval;
+      }
+      results_now.neval = total;
+    }
+
+    if (dead.has_value()) {
+      auto& [death, birth] = dead.value();
+
+      // each process keeps the weights of the rows it reads
+
+      const auto w = summary::weights(death, birth);
+      for (const auto& [begin, end] : rows) {
+        results_now.weights.insert(results_now.weights.end(),
+                                   w.begin() + begin, w.begin() + end);
+      }
+
+      results_now.p_value = p_value(death, birth);
+    }
+
+    results_now.load_balance = load_balance();
+
+    return results_now;
+  }
+
+  bool synchronous() const { return settings.synchronous; }
+
+  const std::optional<timing::Stats>& timing() const { return loglike_timing; }
+
+  int ngroups() const { return std::min(replicates, mpi::get_size()); }
+
   bool no_derived() const {
     return _no_derived
-           || (!settings.write_prior && !settings.write_live
+           || (!in_memory && !settings.write_prior && !settings.write_live
                && !settings.write_resume && !settings.write_dead
                && !settings.posteriors && !settings.equals
                && !settings.write_stats);
   }
 
  private:
+  double p_value(std::vector<double>& death, std::vector<double>& birth) const {
+    const int nlive = replicates * settings.nlive;
+
+    if (batch == 0) {
+      return test::insertion_index_p_value(death, birth, nlive, batch);
+    }
+
+    // each process tests a share of the batches
+
+    test::sort_by_birth(death, birth);
+
+    const std::vector<double> p_values
+        = test::batch_p_values(death, birth, nlive, batch, mpi::get_rank(),
+                               mpi::get_size(), read_threads());
+    double p_value_ = 1.;
+    for (const double& p : p_values) {
+      p_value_ = std::min(p_value_, p);
+    }
+
+    const int nbatches
+        = test::batch_bounds(birth.size(), batch * nlive).size() - 1;
+    return test::combine_p_values(mpi::min(p_value_), nbatches);
+  }
+
+  static int read_threads() {
+    // share cores between processes on a node
+    return std::max(1, read::default_threads() / mpi::get_local_size());
+  }
+
   void fix_settings() {
     settings.nDims = ndims();
     settings.nDerived = nderived();
@@ -447,11 +1926,23 @@ class Model {
   }
 
   const bs_model* model;
-  bs_rng* rng;
+  const bool gq;
   Settings settings;
   const unsigned int seed;
   const int batch = 1;
   const bool _no_derived;
+  const int replicates;
+  std::optional<timing::Stats> loglike_timing;
+  double synchronous_threshold = 0.;
+  mutable timing::Counter counter;
+  mutable std::optional<Results> results_;
+  mutable std::optional<std::vector<variables::Variable>> variables_;
+  mutable std::optional<std::vector<variables::Variable>> flat_variables_;
+  monitor::Options monitor_options;
+  bool in_memory = false;
+  mutable std::vector<capture::Run> captures;
+  std::string stage_dir;  // empty for no staging
+  double stage_interval = 60.;
 };
 
 }  // end namespace polystan
@@ -0,0 +1,132 @@
+#ifndef POLYSTAN_MONITOR_HPP_
+#define POLYSTAN_MONITOR_HPP_
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "polystan/test.hpp"
+
+namespace polystan {
+namespace monitor {
+
+struct Options {
+  bool log = false;
+  double threshold = 0.;  // abort below this p-value; if 0, never abort
+  int patience = 1;       // consecutive batches below threshold to abort
+
+  bool enabled() const { return log || threshold > 0.; }
+};
+
+class Monitor {
+  // insertion index test of dead points as they are produced. batches are
+  // consecutive points in order of death, as they arrive, rather than in order
+  // of birth as in test::batch_p_values, so p-values of batches differ from
+  // those found after the run. a run is aborted once the p-values of
+  // consecutive batches are below the threshold. the smallest p-value so
+  // far, corrected for the number of batches tested as in
+  // test::combine_p_values, is only reported, as it stays low once one batch
+  // is low
+
+ public:
+  Monitor(const Options& options, int nlive, int batch,
+          test::Online* shared = nullptr)
+      : options(options),
+        nlive(nlive),
+        batch_size(batch * nlive),
+        histogram(nlive + 1, 0),
+        online(shared != nullptr ? *shared : own) {}
+
+  void update(int ndead, int npars, const double* dead) {
+    // rows of dead are parameters, derived parameters, death and birth.
+    // indexes of new rows are kept until the next update
+
+    latest_.clear();
+
+    for (int i = online.size(); i < ndead; ++i) {
+      const double death = dead[i * npars + npars - 2];
+      const double birth = dead[i * npars + npars - 1];
+      const int index = online.add(death, birth);
+      latest_.push_back(index);
+
+      histogram[std::clamp(index, 0, nlive)]++;
+      count++;
+
+      if (count == batch_size) {
+        test_batch();
+        std::fill(histogram.begin(), histogram.end(), 0);
+        count = 0;
+      }
+    }
+
+    if (batch_size == 0 && count > 0) {
+      test_batch();
+    }
+  }
+
+  std::string report() const {
+    std::stringstream message;
+    message << "Insertion index test: ndead = " << online.size();
+    if (nbatches > 0 && batch_size == 0) {
+      message << ", p-value = " << p_value;
+    } else if (nbatches > 0) {
+      message << ", p-value of batch " << nbatches << " = " << p_value
+              << ", corrected minimum = " << corrected;
+    }
+    if (options.threshold > 0.) {
+      message << ", batches below " << options.threshold << " = " << nlow
+              << " / " << options.patience;
+    }
+    return message.str();
+  }
+
+  bool log() const { return options.log; }
+
+  const std::vector<int>& latest() const { return latest_; }
+
+  bool abort() const {
+    return options.threshold > 0. && nlow >= options.patience;
+  }
+
+ private:
+  void test_batch() {
+    std::vector<double> cmf(histogram.size());
+    double total = 0.;
+    for (int i = 0; i < histogram.size(); ++i) {
+      total += histogram[i];
+      cmf[i] = total / count;
+    }
+
+    p_value = test::ks_test_uniform(cmf, count);
+    nbatches++;
+
+    if (batch_size == 0) {
+      corrected = p_value;
+    } else {
+      min_p_value = std::min(min_p_value, p_value);
+      corrected = test::combine_p_values(min_p_value, nbatches);
+    }
+
+    nlow = p_value < options.threshold ? nlow + 1 : 0;
+  }
+
+  const Options options;
+  const int nlive;
+  const int batch_size;  // if 0, one batch of all points
+  std::vector<int> histogram;
+  int count = 0;
+  test::Online own;
+  test::Online& online;  // own, or shared with a capture of the run
+  std::vector<int> latest_;
+  int nbatches = 0;
+  double p_value = 1.;
+  double min_p_value = 1.;
+  double corrected = 1.;
+  int nlow = 0;
+};
+
+}  // end namespace monitor
+}  // end namespace polystan
+
+#endif  // POLYSTAN_MONITOR_HPP_
@@ -5,12 +5,19 @@
 #include <mpi.h>
 #endif
 
+#include <cstdint>
+#include <cstdlib>
+#include <numeric>
+#include <vector>
+
 namespace polystan {
 namespace mpi {
 
 void initialize() {
+  // only the main thread makes MPI calls; other threads parse and process
 #ifdef USE_MPI
-  MPI_Init(NULL, NULL);
+  int provided;
+  MPI_Init_thread(NULL, NULL, MPI_THREAD_FUNNELED, &provided);
 #endif
 }
 
@@ -32,12 +39,67 @@ MPI_Comm& get_comm() {
   return comm;
 }
 
+MPI_Comm split(int color) {
+  int rank;
+  MPI_Comm_rank(get_comm(), &rank);
+  MPI_Comm comm;
+  MPI_Comm_split(get_comm(), color, rank, &comm);
+  return comm;
+}
+
+void free(MPI_Comm& comm) {
+  if (comm != get_comm()) {
+    MPI_Comm_free(&comm);
+  }
+}
+#endif
+
 int get_size() {
+#ifdef USE_MPI
   int size;
   MPI_Comm_size(get_comm(), &size);
   return size;
+#else
+  return 1;
+#endif
 }
+
+int get_rank() {
+#ifdef USE_MPI
+  int rank;
+  MPI_Comm_rank(get_comm(), &rank);
+  return rank;
+#else
+  return 0;
 #endif
+}
+
+int get_local_size() {
+  // number of processes on this node
+#ifdef USE_MPI
+  static const int size = [] {
+    MPI_Comm local;
+    MPI_Comm_split_type(get_comm(), MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL,
+                        &local);
+    int size_;
+    MPI_Comm_size(local, &size_);
+    MPI_Comm_free(&local);
+    return size_;
+  }();
+  return size;
+#else
+  return 1;
+#endif
+}
+
+void abort(int code) {
+  // stop every process, from any one of them
+#ifdef USE_MPI
+  MPI_Abort(MPI_COMM_WORLD, code);
+#else
+  std::exit(code);
+#endif
+}
 
 void barrier() {
 #ifdef USE_MPI
@@ -45,13 +107,115 @@ void barrier() {
 #endif
 }
 
-bool is_rank_zero() {
+bool is_rank_zero() { return get_rank() == 0; }
+
 #ifdef USE_MPI
-  int rank;
-  MPI_Comm_rank(get_comm(), &rank);
-  return rank == 0;
+template <typename T>
+MPI_Datatype datatype();
+
+template <>
+MPI_Datatype datatype<double>() {
+  return MPI_DOUBLE;
+}
+
+template <>
+MPI_Datatype datatype<int>() {
+  return MPI_INT;
+}
+
+template <>
+MPI_Datatype datatype<std::int64_t>() {
+  return MPI_INT64_T;
+}
+
+std::vector<int> displacements(const std::vector<int>& counts) {
+  std::vector<int> displs(counts.size(), 0);
+  std::partial_sum(counts.begin(), counts.end() - 1, displs.begin() + 1);
+  return displs;
+}
+#endif
+
+template <typename T>
+std::vector<T> gather(const std::vector<T>& local) {
+  // concatenate in rank order on rank zero; empty on other ranks
+#ifdef USE_MPI
+  const int count = local.size();
+  std::vector<int> counts(get_size());
+  MPI_Gather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, get_comm());
+
+  const std::vector<int> displs = displacements(counts);
+  std::vector<T> global;
+
+  if (is_rank_zero()) {
+    global.resize(displs.back() + counts.back());
+  }
+
+  MPI_Gatherv(local.data(), count, datatype<T>(), global.data(),
+              counts.data(), displs.data(), datatype<T>(), 0, get_comm());
+  return global;
+#else
+  return local;
+#endif
+}
+
+template <typename T>
+std::vector<T> allgather(const std::vector<T>& local) {
+  // concatenate in rank order on every rank
+#ifdef USE_MPI
+  const int count = local.size();
+  std::vector<int> counts(get_size());
+  MPI_Allgather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, get_comm());
+
+  const std::vector<int> displs = displacements(counts);
+  std::vector<T> global(displs.back() + counts.back());
+
+  MPI_Allgatherv(local.data(), count, datatype<T>(), global.data(),
+                 counts.data(), displs.data(), datatype<T>(), get_comm());
+  return global;
+#else
+  return local;
+#endif
+}
+
+template <typename T>
+T broadcast(T value) {
+  // value on rank zero
+#ifdef USE_MPI
+  MPI_Bcast(&value, 1, datatype<T>(), 0, get_comm());
+#endif
+  return value;
+}
+
+template <typename T>
+T min(T local) {
+#ifdef USE_MPI
+  T global;
+  MPI_Allreduce(&local, &global, 1, datatype<T>(), MPI_MIN, get_comm());
+  return global;
+#else
+  return local;
+#endif
+}
+
+template <typename T>
+T max(T local) {
+#ifdef USE_MPI
+  T global;
+  MPI_Allreduce(&local, &global, 1, datatype<T>(), MPI_MAX, get_comm());
+  return global;
+#else
+  return local;
+#endif
+}
+
+template <typename T>
+T sum(T local) {
+#ifdef USE_MPI
+  T global;
+  MPI_Allreduce(&local, &global, 1, datatype<T>(), MPI_SUM, get_comm());
+  return global;
 #else
-  return true;
+  return local;
 #endif
 }
 
@@ -0,0 +1,144 @@
+#ifndef POLYSTAN_NPY_HPP_
+#define POLYSTAN_NPY_HPP_
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "polystan/async.hpp"
+#include "polystan/json.hpp"
+
+namespace polystan {
+namespace npy {
+
+bool little_endian() {
+  const std::uint16_t one = 1;
+  return *reinterpret_cast<const char*>(&one) == 1;
+}
+
+std::string header(const std::vector<std::int64_t>& shape) {
+  // version 1.0 header padded so that data is 64-byte aligned
+
+  std::string shape_;
+  for (const std::int64_t extent : shape) {
+    shape_ += std::to_string(extent) + (shape.size() == 1 ? "," : ", ");
+  }
+  if (shape.size() > 1) {
+    shape_.resize(shape_.size() - 2);
+  }
+
+  const std::string magic("\x93NUMPY\x01\x00", 8);
+  std::string dict = std::string("{'descr': '") + (little_endian() ? '<' : '>')
+                     + "f8', 'fortran_order': False, 'shape': (" + shape_
+                     + "), }";
+
+  const std::size_t unpadded = magic.size() + 2 + dict.size() + 1;
+  dict.append((64 - unpadded % 64) % 64, ' ');
+  dict.push_back('\n');
+
+  const std::uint16_t length = dict.size();
+  std::string result(magic);
+  result.push_back(static_cast<char>(length & 0xff));
+  result.push_back(static_cast<char>(length >> 8));
+  return result + dict;
+}
+
+void write(async::Files& files, const std::string& npy_file_name,
+           const std::vector<double>& data,
+           const std::vector<std::int64_t>& shape) {
+  // data in C order
+  const std::string header_ = header(shape);
+  const std::size_t size = data.size() * sizeof(double);
+  auto& out = files.open(npy_file_name, header_.size() + size);
+  out.write(header_);
+  out.write(reinterpret_cast<const char*>(data.data()), size);
+}
+
+class Bundle {
+  // one npy file per variable, of shape chain, draw and then the shape of
+  // the variable, and a JSON manifest of metadata and files
+
+ public:
+  explicit Bundle(const std::string& dir_name) : dir(dir_name) {
+    std::filesystem::create_directories(dir);
+  }
+
+  void add(const std::string& group, const std::string& name,
+           const std::vector<double>& data, const std::vector<int>& shape) {
+    const std::int64_t size = std::accumulate(
+        shape.begin(), shape.end(), std::int64_t(1), std::multiplies<>());
+    std::vector<std::int64_t> shape_{1, std::int64_t(data.size()) / size};
+    shape_.insert(shape_.end(), shape.begin(), shape.end());
+
+    const std::filesystem::path relative
+        = std::filesystem::path(group) / (name + ".npy");
+    std::filesystem::create_directories(dir / group);
+    write(out, dir / relative, data, shape_);
+    files(group).emplace_back(name, relative);
+  }
+
+  void missing(const std::string& group, const std::string& metadata) {
+    missing_.emplace_back(group, metadata);
+  }
+
+  async::Report write_manifest(const json::Object& metadata,
+                               const json::Object& sample_stats) {
+    async::Report report = out.close();
+    json::Stream stream(dir / "manifest.json");
+    stream.start_object();
+    stream.add("posterior_attrs", metadata);
+    stream.add("prior_attrs", metadata);
+    stream.add("sample_stats_attrs", metadata);
+    stream.add("sample_stats", sample_stats);
+
+    for (const auto& [group, names] : files_) {
+      stream.key(group);
+      stream.start_object();
+      for (const auto& [name, file_name] : names) {
+        stream.add(name, file_name);
+      }
+      stream.end_object();
+    }
+
+    for (const auto& [group, metadata_] : missing_) {
+      stream.key(group);
+      stream.start_object();
+      stream.add("metadata", metadata_);
+      stream.end_object();
+    }
+
+    stream.end_object();
+    report += stream.close();
+    return report;
+  }
+
+ private:
+  std::vector<std::pair<std::string, std::string>>& files(
+      const std::string& group) {
+    for (auto& [group_, names] : files_) {
+      if (group_ == group) {
+        return names;
+      }
+    }
+    files_.emplace_back(group,
+                        std::vector<std::pair<std::string, std::string>>());
+    return files_.back().second;
+  }
+
+  const std::filesystem::path dir;
+  std::vector<std::pair<std::string,
+                        std::vector<std::pair<std::string, std::string>>>>
+      files_;
+  std::vector<std::pair<std::string, std::string>> missing_;
+  async::Files out;
+};
+
+}  // end namespace npy
+}  // end namespace polystan
+
+#endif  // POLYSTAN_NPY_HPP_
@@ -0,0 +1,37 @@
+#ifndef POLYSTAN_OUTPUT_HPP_
+#define POLYSTAN_OUTPUT_HPP_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "polystan/json.hpp"
+#include "polystan/thin.hpp"
+
+namespace polystan {
+
+struct Output {
+  // where and how results are written. empty names are not written
+
+  std::string json_file_name;
+  std::string toml_file_name;
+  json::Format format;
+  std::string npy_dir;
+  std::string zarr_dir;
+  int zarr_chunk_size = 100000;  // draws per chunk
+  thin::Options thinning;
+  bool flat = false;  // one JSON key per element of arrays
+  bool deduplicate = false;  // unique posterior samples and multiplicities
+  bool no_samples = false;  // only summaries of dead points, no samples
+  bool summary = false;  // weighted statistics of each parameter
+  bool sketch = false;   // quantiles of each parameter from bounded sketches
+  std::vector<double> quantiles{0.025, 0.16, 0.5, 0.84, 0.975};
+  int histogram_bins = 0;  // 0 for no histograms
+  std::vector<std::pair<std::string, std::string>> histogram_pairs;
+  int compress = 0;  // gzip level of JSON and Zarr chunks, 0 for none
+  std::string archive_file_name;  // one file holding all of a run's files
+};
+
+}  // end namespace polystan
+
+#endif  // POLYSTAN_OUTPUT_HPP_
@@ -0,0 +1,110 @@
+#ifndef POLYSTAN_PIPELINE_HPP_
+#define POLYSTAN_PIPELINE_HPP_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "polystan/capture.hpp"
+
+namespace polystan {
+namespace pipeline {
+
+struct Dump {
+  // new dead points and current live points from one call of the dumper
+  int npars;
+  int nrows;
+  std::vector<double> dead;
+  std::vector<int> indexes;  // of dead, if found already, or empty
+  int nlive;
+  std::vector<double> live;
+  double logz;
+  double logzerr;
+};
+
+class Worker {
+  // processes dumps of a run captured with output --in-memory on a
+  // background thread while PolyChord keeps sampling. the dumper only copies
+  // new rows. the worker makes no MPI calls. runs written to files are
+  // processed after sampling
+
+ public:
+  explicit Worker(capture::Run& run) : run(run), thread([this] { loop(); }) {}
+
+  Worker(const Worker&) = delete;
+  Worker& operator=(const Worker&) = delete;
+
+  ~Worker() { finish(); }
+
+  void push(int ndead, int nlive, int npars, const double* live,
+            const double* dead, double logz, double logzerr,
+            const std::vector<int>& indexes = {}) {
+    Dump dump{npars,
+              ndead - submitted,
+              std::vector<double>(dead + submitted * npars,
+                                  dead + ndead * npars),
+              indexes,
+              nlive,
+              std::vector<double>(live, live + nlive * npars),
+              logz,
+              logzerr};
+    submitted = ndead;
+
+    {
+      const std::lock_guard<std::mutex> lock(mutex);
+      queue.push_back(std::move(dump));
+    }
+    ready.notify_one();
+  }
+
+  void finish() {
+    // process remaining dumps and stop
+
+    if (!thread.joinable()) {
+      return;
+    }
+
+    {
+      const std::lock_guard<std::mutex> lock(mutex);
+      done = true;
+    }
+    ready.notify_one();
+    thread.join();
+  }
+
+ private:
+  void loop() {
+    while (true) {
+      std::unique_lock<std::mutex> lock(mutex);
+      ready.wait(lock, [this] { return done || !queue.empty(); });
+
+      if (queue.empty()) {
+        return;
+      }
+
+      Dump dump = std::move(queue.front());
+      queue.pop_front();
+      lock.unlock();
+
+      run.add_dead(dump.nrows, dump.npars, dump.dead.data(), dump.indexes);
+      run.set_live(dump.nlive, dump.npars, dump.live.data(), dump.logz,
+                   dump.logzerr);
+    }
+  }
+
+  capture::Run& run;
+  int submitted = 0;
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::deque<Dump> queue;
+  bool done = false;
+  std::thread thread;
+};
+
+}  // end namespace pipeline
+}  // end namespace polystan
+
+#endif  // POLYSTAN_PIPELINE_HPP_
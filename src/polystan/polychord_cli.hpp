@@ -19,7 +19,8 @@ void AddFlag(CLI::App* app, std::string flag, bool& var, std::string help) {
   app->add_flag(flag, var, help)->default_val(var)->default_str(bool2str(var));
 }
 
-void AddPolyChord(CLI::App* app, Settings* settings, bool& no_derived) {
+void AddPolyChord(CLI::App* app, Settings* settings, bool& no_derived,
+                  int& timing_samples, double& timing_threshold) {
   app->add_option("--nlive", settings->nlive,
                   "The number of live points. Increasing nlive increases the "
                   "accuracy of posteriors and evidences, and proportionally "
@@ -120,6 +121,20 @@ void AddPolyChord(CLI::App* app, Settings* settings, bool& no_derived) {
       "parallelisation is less effective than asynchronous by a factor "
       "~O(1) for large parallelisation.");
 
+  app->add_option(
+         "--auto-synchronous", timing_samples,
+         "Time this number of likelihood evaluations at prior draws before "
+         "running, and choose asynchronous workers if the coefficient of "
+         "variation of the evaluation time exceeds "
+         "--auto-synchronous-threshold. If 0, use --synchronous setting.")
+      ->check(CLI::NonNegativeNumber);
+
+  app->add_option("--auto-synchronous-threshold", timing_threshold,
+                  "Coefficient of variation of likelihood evaluation time "
+                  "above which --auto-synchronous chooses asynchronous "
+                  "workers.")
+      ->check(CLI::PositiveNumber);
+
   app->add_option("--base-dir", settings->base_dir,
                   "Where to store output files.");
 
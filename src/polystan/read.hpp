@@ -1,16 +1,36 @@
 #ifndef POLYSTAN_READ_HPP_
 #define POLYSTAN_READ_HPP_
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <array>
-#include <fstream>
-#include <iterator>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <memory>
+#include <numeric>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "polystan/archive.hpp"
+#include "polystan/gzip.hpp"
+
 namespace polystan {
 namespace read {
 
+typedef std::vector<std::vector<double>> Columns;
+
 std::vector<std::string> param_names(const std::string& csv) {
   std::stringstream stream(csv);
   std::vector<std::string> result;
@@ -24,147 +44,661 @@ std::vector<std::string> param_names(const std::string& csv) {
   return result;
 }
 
-std::vector<std::vector<double>> samples(
-    const std::string& equal_weights_file_name) {
-  std::ifstream ifs(equal_weights_file_name);
+class Mapped {
+  // read-only memory map of a whole file, or of a member of an archive,
+  // e.g., run.zip/x.txt. gzip files, and files that were replaced by a gzip
+  // copy, are instead decompressed into memory
+
+ public:
+  explicit Mapped(const std::string& file_name) {
+    std::string archive_file_name;
+    std::string member;
+
+    if (archive::split(file_name, archive_file_name, member)) {
+      extract(archive_file_name, member);
+      return;
+    }
+
+    if (gzip::has_suffix(file_name)) {
+      inflate(file_name);
+      return;
+    }
 
-  if (!ifs) {
-    throw std::runtime_error("Could not read equally weighted samples from "
-                             + equal_weights_file_name);
+    const int fd = ::open(file_name.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+      inflate(file_name + gzip::SUFFIX);
+      return;
+    }
+
+    struct stat info;
+
+    if (::fstat(fd, &info) == 0) {
+      map(fd, 0, info.st_size);
+    }
+
+    ::close(fd);
   }
 
-  std::vector<std::vector<double>> data;
-  std::string record;
+  Mapped(const Mapped&) = delete;
+  Mapped& operator=(const Mapped&) = delete;
+
+  ~Mapped() {
+    if (map_ != nullptr) {
+      ::munmap(map_, map_size);
+    }
+  }
+
+  explicit operator bool() const { return ok; }
 
-  while (std::getline(ifs, record)) {
-    std::istringstream iss(record);
-    std::istream_iterator<double> iter(iss);
-    iter++;  // we ignore weight column
-    std::vector<double> row((iter), std::istream_iterator<double>());
+  const char* begin() const { return data_; }
 
-    if (data.empty()) {
-      data.resize(row.size());
+  const char* end() const { return data_ + size_; }
+
+ private:
+  void map(int fd, std::uint64_t offset, std::size_t size) {
+    // map size bytes from offset, which needn't be page aligned
+
+    size_ = size;
+
+    if (size_ == 0) {
+      ok = true;
+      return;
+    }
+
+    const std::uint64_t page = ::sysconf(_SC_PAGESIZE);
+    const std::uint64_t start = offset / page * page;
+    map_size = size_ + (offset - start);
+    void* map_data
+        = ::mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, start);
+
+    if (map_data != MAP_FAILED) {
+      ::madvise(map_data, map_size, MADV_SEQUENTIAL);
+      map_ = map_data;
+      data_ = static_cast<const char*>(map_) + (offset - start);
+      ok = true;
     }
+  }
 
-    data[0].push_back(-0.5 * row[0]);  // convert from -2 * loglike
+  void extract(const std::string& archive_file_name,
+               const std::string& member) {
+    // stored members are mapped in place and gzip members inflated
 
-    // look at parameters
+    const archive::Index index(archive_file_name);
 
-    for (int i = 1; i < row.size(); i++) {
-      data[i].push_back(row[i]);
+    if (!index) {
+      return;
+    }
+
+    auto entry = index.find(member);
+    const bool gz = !entry.has_value() || gzip::has_suffix(member);
+
+    if (!entry.has_value()) {
+      entry = index.find(member + gzip::SUFFIX);
+    }
+
+    if (!entry.has_value() || !entry->stored) {
+      return;
+    }
+
+    map(index.descriptor(), entry->offset, entry->size);
+
+    if (ok && gz) {
+      std::string data;
+      ok = gzip::decompress(data_, size_, data);
+      if (map_ != nullptr) {
+        ::munmap(map_, map_size);
+        map_ = nullptr;
+      }
+      inflated.swap(data);
+      data_ = inflated.data();
+      size_ = inflated.size();
     }
   }
 
-  return data;
+  void inflate(const std::string& gz_file_name) {
+    if (gzip::decompress_file(gz_file_name, inflated)) {
+      data_ = inflated.data();
+      size_ = inflated.size();
+      ok = true;
+    }
+  }
+
+  bool ok = false;
+  void* map_ = nullptr;
+  std::size_t map_size = 0;
+  std::string inflated;
+  const char* data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+const char* parse(const char* first, const char* last, double& value) {
+  // parse a number after any whitespace and return the end of it
+
+  while (first < last && is_space(*first)) {
+    ++first;
+  }
+
+#if __cpp_lib_to_chars >= 201611L
+  const auto result = std::from_chars(first, last, value);
+  if (result.ec != std::errc()) {
+    throw std::runtime_error("Could not parse " + std::string(first, last));
+  }
+  return result.ptr;
+#else
+  char* ptr;
+  value = std::strtod(first, &ptr);
+  if (ptr == first) {
+    throw std::runtime_error("Could not parse " + std::string(first, last));
+  }
+  return ptr;
+#endif
 }
 
-std::array<std::vector<double>, 2> death_birth(
-    const std::string& death_birth_file_name) {
-  std::ifstream ifs(death_birth_file_name);
+const char* skip(const char* first, const char* last) {
+  // skip whitespace and then a token
 
-  if (!ifs) {
-    throw std::runtime_error("Could not read dead points from "
-                             + death_birth_file_name);
+  while (first < last && is_space(*first)) {
+    ++first;
   }
+  while (first < last && !is_space(*first) && *first != '\n') {
+    ++first;
+  }
+  return first;
+}
 
-  std::array<std::vector<double>, 2> data;
-  std::string record;
+const char* parse_back(const char* first, const char* last, double& value) {
+  // parse the number ending before last, ignoring trailing whitespace, and
+  // return the start of it
 
-  while (std::getline(ifs, record)) {
-    std::istringstream iss(record);
-    std::istream_iterator<double> iter(iss);
-    std::vector<double> row((iter), std::istream_iterator<double>());
-    data[0].push_back(row[row.size() - 2]);
-    data[1].push_back(row[row.size() - 1]);
+  while (last > first && is_space(*(last - 1))) {
+    --last;
+  }
+  const char* start = last;
+  while (start > first && !is_space(*(start - 1))) {
+    --start;
   }
+  parse(start, last, value);
+  return start;
+}
 
-  return data;
+int count_columns(const char* first, const char* last) {
+  const char* eol = std::find(first, last, '\n');
+  int n = 0;
+
+  while (true) {
+    while (first < eol && is_space(*first)) {
+      ++first;
+    }
+    if (first == eol) {
+      return n;
+    }
+    first = skip(first, eol);
+    n++;
+  }
 }
 
-int neval(const std::string& stats_file_name) {
-  const std::string prefix = " nlike:";
+const char* line_start(const char* first, const char* last, const char* p) {
+  // first line starting at or after p
 
-  std::ifstream ifs(stats_file_name);
+  if (p == first) {
+    return p;
+  }
+  const char* eol = std::find(p - 1, last, '\n');
+  return eol == last ? last : eol + 1;
+}
+
+std::vector<const char*> chunks(const Mapped& mapped, int part, int nparts,
+                                int nthreads) {
+  // bounds of nthreads chunks of lines starting in part of nparts equal byte
+  // ranges
+
+  const char* first = mapped.begin();
+  const char* last = mapped.end();
+  const std::size_t size = last - first;
+  const std::size_t begin = size * part / nparts;
+  const std::size_t end = size * (part + 1) / nparts;
+
+  std::vector<const char*> bounds;
 
-  if (!ifs) {
-    throw std::runtime_error("Could not read neval from " + stats_file_name);
+  for (int k = 0; k <= nthreads; k++) {
+    const std::size_t p = begin + (end - begin) * k / nthreads;
+    bounds.push_back(line_start(first, last, first + p));
   }
 
-  std::string record;
+  return bounds;
+}
+
+std::size_t count_lines(const char* first, const char* last) {
+  if (first == last) {
+    return 0;
+  }
+  return std::count(first, last, '\n') + (*(last - 1) != '\n');
+}
+
+int default_threads() {
+  return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+template <typename F>
+void parallel(int nthreads, F f) {
+  // call f(k) for each thread k, rethrowing the first exception
+
+  std::vector<std::thread> threads;
+  std::vector<std::exception_ptr> errors(nthreads);
+
+  for (int k = 0; k < nthreads; k++) {
+    threads.emplace_back([&, k]() {
+      try {
+        f(k);
+      } catch (...) {
+        errors[k] = std::current_exception();
+      }
+    });
+  }
 
-  while (std::getline(ifs, record)) {
-    if (record.rfind(prefix, 0) == 0) {
-      break;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (const auto& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
     }
   }
+}
+
+template <typename F, typename G>
+std::size_t for_each_line(const Mapped& mapped, int part, int nparts,
+                          int nthreads, F f, G allocate) {
+  // count lines in parallel, allocate storage, and then call
+  // f(row, line begin, line end), or f(thread, row, line begin, line end),
+  // in parallel
 
-  const std::string data(record.substr(prefix.size()));
-  return std::stoi(data);
+  if (nthreads <= 0) {
+    nthreads = default_threads();
+  }
+
+  const auto bounds = chunks(mapped, part, nparts, nthreads);
+  std::vector<std::size_t> offsets(nthreads + 1, 0);
+
+  parallel(nthreads, [&](int k) {
+    offsets[k + 1] = count_lines(bounds[k], bounds[k + 1]);
+  });
+
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+  allocate(offsets.back());
+
+  parallel(nthreads, [&](int k) {
+    std::size_t row = offsets[k];
+    const char* first = bounds[k];
+    while (first < bounds[k + 1]) {
+      const char* eol = std::find(first, bounds[k + 1], '\n');
+      if constexpr (std::is_invocable_v<F, int, std::size_t, const char*,
+                                        const char*>) {
+        f(k, row++, first, eol);
+      } else {
+        f(row++, first, eol);
+      }
+      first = eol + 1;
+    }
+  });
+
+  return offsets.back();
+}
+
+std::vector<std::int64_t> all_rows(std::size_t n) {
+  std::vector<std::int64_t> rows(n);
+  std::iota(rows.begin(), rows.end(), 0);
+  return rows;
 }
 
-int ess(const std::string& stats_file_name) {
-  const std::string prefix = " nequals:";
+std::vector<double> deduplicate(Columns& data) {
+  // collapse runs of identical rows into their first row and return the
+  // multiplicity of each row that remains
+
+  const std::size_t n = data.empty() ? 0 : data[0].size();
+  std::vector<double> multiplicity;
+  multiplicity.reserve(n);
+
+  std::size_t unique = 0;
 
-  std::ifstream ifs(stats_file_name);
+  for (std::size_t row = 0; row < n; row++) {
+    const bool repeat = unique > 0 && std::all_of(
+        data.begin(), data.end(),
+        [&](const auto& column) { return column[row] == column[unique - 1]; });
+
+    if (repeat) {
+      multiplicity.back() += 1.;
+      continue;
+    }
 
-  if (!ifs) {
-    throw std::runtime_error("Could not read ESS from " + stats_file_name);
+    for (auto& column : data) {
+      column[unique] = column[row];
+    }
+    multiplicity.push_back(1.);
+    unique++;
   }
 
-  std::string record;
+  for (auto& column : data) {
+    column.resize(unique);
+    column.shrink_to_fit();
+  }
+
+  return multiplicity;
+}
+
+class Samples {
+  // equally weighted samples of part of a file, which is mapped once and
+  // parsed a column at a time as columns are taken, so that only the columns
+  // being written are held in memory, besides a cursor into the line of each
+  // kept row. columns that follow those of the file, e.g., multiplicities,
+  // or samples made in memory, are held
+
+ public:
+  Samples() = default;
+
+  explicit Samples(Columns held_) : held(std::move(held_)) {}
+
+  template <typename S = std::vector<std::int64_t> (*)(std::size_t)>
+  Samples(const std::string& equal_weights_file_name, int part, int nparts,
+          int nthreads, S select = all_rows)
+      : mapped(std::make_unique<Mapped>(equal_weights_file_name)),
+        nthreads(nthreads > 0 ? nthreads : default_threads()) {
+    if (!*mapped) {
+      throw std::runtime_error("Could not read equally weighted samples from "
+                               + equal_weights_file_name);
+    }
+
+    // we ignore weight column
+
+    ncols = std::max(count_columns(mapped->begin(), mapped->end()) - 1, 0);
+
+    std::vector<std::int64_t> slots;  // of each row, or -1 if not kept
+
+    for_each_line(
+        *mapped, part, nparts, this->nthreads,
+        [&](std::size_t row, const char* first, const char* last) {
+          const std::int64_t slot = slots[row];
+          if (slot >= 0) {
+            cursors[slot] = first;
+            ends[slot] = last;
+          }
+        },
+        [&](std::size_t n) {
+          const std::vector<std::int64_t> rows = select(n);
+          slots.assign(n, -1);
+          for (std::size_t k = 0; k < rows.size(); k++) {
+            slots[rows[k]] = k;
+          }
+          cursors.resize(rows.size());
+          ends.resize(rows.size());
+        });
+
+    // rows identical to the row kept before are not parsed, as resampled
+    // points are repeated
+
+    repeats.assign(cursors.size(), 0);
+    for_each_slot([&](std::size_t slot) {
+      repeats[slot] = slot > 0
+                      && ends[slot] - cursors[slot]
+                             == ends[slot - 1] - cursors[slot - 1]
+                      && std::equal(cursors[slot], ends[slot],
+                                    cursors[slot - 1]);
+    });
+    for_each_slot([&](std::size_t slot) {
+      cursors[slot] = skip(cursors[slot], ends[slot]);
+    });
+  }
+
+  std::size_t size() const {
+    // number of rows
+    return mapped ? cursors.size() : held.empty() ? 0 : held[0].size();
+  }
+
+  void resize(int n) {
+    // pad with empty columns, e.g., for derived parameters that were not
+    // written
+    held.resize(std::max(n - ncols, 0));
+  }
+
+  void push_back(std::vector<double> column) {
+    held.push_back(std::move(column));
+  }
+
+  std::vector<double> take(int i) {
+    // column i, which is no longer held
+
+    if (i >= ncols) {
+      std::vector<double> column;
+      column.swap(held[i - ncols]);
+      return column;
+    }
+
+    if (i < parsed) {
+      // back to the first column after the weight
+      for_each_slot([&](std::size_t slot) {
+        const char* first = cursors[slot];
+        while (first > mapped->begin() && *(first - 1) != '\n') {
+          --first;
+        }
+        cursors[slot] = skip(first, ends[slot]);
+      });
+      parsed = 0;
+    }
+
+    std::vector<double> column(cursors.size());
+
+    for_each_slot([&](std::size_t slot) {
+      if (repeats[slot]) {
+        return;
+      }
+      const char* first = cursors[slot];
+      for (int k = parsed; k < i; k++) {
+        first = skip(first, ends[slot]);
+      }
+      cursors[slot] = parse(first, ends[slot], column[slot]);
+    });
+
+    for (std::size_t slot = 1; slot < column.size(); slot++) {
+      if (repeats[slot]) {
+        column[slot] = column[slot - 1];
+      }
+    }
+
+    if (i == 0) {
+      for (auto& value : column) {
+        value *= -0.5;  // convert from -2 * loglike
+      }
+    }
+
+    parsed = i + 1;
+    return column;
+  }
+
+  std::vector<double> deduplicate() {
+    // collapse runs of identical rows into their first row and return the
+    // multiplicity of each row that remains
 
-  while (std::getline(ifs, record)) {
-    if (record.rfind(prefix, 0) == 0) {
-      break;
+    if (!mapped) {
+      return read::deduplicate(held);
     }
+
+    std::vector<double> multiplicity;
+    std::size_t unique = 0;
+
+    for (std::size_t slot = 0; slot < cursors.size(); slot++) {
+      if (repeats[slot]) {
+        multiplicity.back() += 1.;
+        continue;
+      }
+      cursors[unique] = cursors[slot];
+      ends[unique] = ends[slot];
+      multiplicity.push_back(1.);
+      unique++;
+    }
+
+    cursors.resize(unique);
+    cursors.shrink_to_fit();
+    ends.resize(unique);
+    ends.shrink_to_fit();
+    repeats.assign(unique, 0);
+
+    return multiplicity;
+  }
+
+ private:
+  template <typename F>
+  void for_each_slot(F f) {
+    // call f(slot) for consecutive shares of the rows on each thread
+
+    const std::size_t n = cursors.size();
+    const int nthreads_ = std::max<int>(1, std::min<std::size_t>(nthreads, n));
+
+    parallel(nthreads_, [&](int k) {
+      const std::size_t end = n * (k + 1) / nthreads_;
+      for (std::size_t slot = n * k / nthreads_; slot < end; slot++) {
+        f(slot);
+      }
+    });
   }
 
-  const std::string data(record.substr(prefix.size()));
-  return std::stoi(data);
+  std::unique_ptr<Mapped> mapped;
+  int nthreads = 1;
+  int ncols = 0;  // of the file, after the weight
+  int parsed = 0;  // columns before cursors
+  std::vector<const char*> cursors;
+  std::vector<const char*> ends;
+  std::vector<char> repeats;  // whether a row is identical to the one before
+  Columns held;
+};
+
+std::array<std::vector<double>, 2> death_birth(
+    const std::string& death_birth_file_name, int part = 0, int nparts = 1,
+    int nthreads = 0) {
+  Mapped mapped(death_birth_file_name);
+
+  if (!mapped) {
+    throw std::runtime_error("Could not read dead points from "
+                             + death_birth_file_name);
+  }
+
+  // only the last two columns are parsed, scanning back from line ends
+
+  std::array<std::vector<double>, 2> data;
+
+  for_each_line(
+      mapped, part, nparts, nthreads,
+      [&](std::size_t row, const char* first, const char* last) {
+        last = parse_back(first, last, data[1][row]);
+        parse_back(first, last, data[0][row]);
+      },
+      [&](std::size_t n) {
+        data[0].resize(n);
+        data[1].resize(n);
+      });
+
+  return data;
+}
+
+template <typename F, typename G>
+std::size_t for_each_row(const std::string& file_name, int part, int nparts,
+                         int nthreads, F f, G count) {
+  // call count(number of rows) and then f(thread, row, values) in parallel
+  // for each row, without storing them
+
+  Mapped mapped(file_name);
+
+  if (!mapped) {
+    throw std::runtime_error("Could not read " + file_name);
+  }
+
+  if (nthreads <= 0) {
+    nthreads = default_threads();
+  }
+
+  const int ncols = count_columns(mapped.begin(), mapped.end());
+  std::vector<std::vector<double>> values(nthreads,
+                                          std::vector<double>(ncols));
+
+  return for_each_line(
+      mapped, part, nparts, nthreads,
+      [&](int thread, std::size_t row, const char* first, const char* last) {
+        for (int i = 0; i < ncols; i++) {
+          first = parse(first, last, values[thread][i]);
+        }
+        f(thread, row, values[thread]);
+      },
+      count);
 }
 
-std::array<double, 2> evidence(const std::string& stats_file_name) {
-  const std::string prefix = "log(Z)       =";
+struct Stats {
+  std::array<double, 2> evidence;
+  int ess;
+  int neval;
+};
+
+Stats stats(const std::string& stats_file_name) {
+  // one pass over the stats file for everything we need from it
+
+  const std::string evidence_prefix = "log(Z)       =";
   const std::string delim = "+/-";
+  const std::string ess_prefix = " nequals:";
+  const std::string neval_prefix = " nlike:";
 
-  std::ifstream ifs(stats_file_name);
+  Mapped mapped(stats_file_name);
 
-  if (!ifs) {
-    throw std::runtime_error("Could not read evidence from " + stats_file_name);
+  if (!mapped) {
+    throw std::runtime_error("Could not read stats from " + stats_file_name);
   }
 
-  std::string record;
+  std::istringstream ifs(std::string(mapped.begin(), mapped.end()));
 
-  while (std::getline(ifs, record)) {
-    if (record.rfind(prefix, 0) == 0) {
-      break;
+  Stats data{};
+  std::string record;
+  int found = 0;
+
+  while (found < 3 && std::getline(ifs, record)) {
+    if (record.rfind(evidence_prefix, 0) == 0) {
+      const std::string value(record.substr(evidence_prefix.size()));
+      data.evidence[0] = std::stod(value.substr(0, value.find(delim)));
+      data.evidence[1]
+          = std::stod(value.substr(value.find(delim) + delim.size()));
+      found++;
+    } else if (record.rfind(ess_prefix, 0) == 0) {
+      data.ess = std::stoi(record.substr(ess_prefix.size()));
+      found++;
+    } else if (record.rfind(neval_prefix, 0) == 0) {
+      data.neval = std::stoi(record.substr(neval_prefix.size()));
+      found++;
     }
   }
 
-  const std::string data(record.substr(prefix.size()));
-
-  const double logz = std::stof(data.substr(0, data.find(delim)));
-  const double err = std::stof(data.substr(data.find(delim) + delim.size()));
+  if (found < 3) {
+    throw std::runtime_error("Could not read stats from " + stats_file_name);
+  }
 
-  return {logz, err};
+  return data;
 }
 
-std::vector<double> weight(const std::string& txt_file_name) {
-  std::ifstream ifs(txt_file_name);
+std::vector<double> weight(const std::string& txt_file_name,
+                           int nthreads = 0) {
+  Mapped mapped(txt_file_name);
 
-  if (!ifs) {
+  if (!mapped) {
     throw std::runtime_error("Could not weights from " + txt_file_name);
   }
 
   std::vector<double> data;
-  std::string record;
 
-  while (std::getline(ifs, record)) {
-    std::istringstream iss(record);
-    std::istream_iterator<double> iter(iss);
-    std::vector<double> row((iter), std::istream_iterator<double>());
-    data.push_back(row[0]);
-  }
+  for_each_line(
+      mapped, 0, 1, nthreads,
+      [&](std::size_t row, const char* first, const char* last) {
+        parse(first, last, data[row]);
+      },
+      [&](std::size_t n) { data.resize(n); });
 
   return data;
 }
@@ -0,0 +1,61 @@
+#ifndef POLYSTAN_RNG_HPP_
+#define POLYSTAN_RNG_HPP_
+
+#include <cstdint>
+#include <cstring>
+
+namespace polystan {
+namespace rng {
+
+// counter-based random numbers. the n-th draw of a stream is a function of
+// the stream key and n alone, so draws may be made on any process in any order
+
+const std::uint64_t GAMMA = 0x9e3779b97f4a7c15;
+
+std::uint64_t mix(std::uint64_t x) {
+  // SplitMix64 finalizer, a bijection with good avalanche
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+  return x ^ (x >> 31);
+}
+
+class Stream {
+ public:
+  explicit Stream(std::uint64_t key) : key(mix(key)) {}
+
+  std::uint64_t operator()(std::uint64_t counter) const {
+    return mix(key + (counter + 1) * GAMMA);
+  }
+
+  double uniform(std::uint64_t counter) const {
+    // 53 random bits in [0, 1)
+    return ((*this)(counter) >> 11) * 0x1.0p-53;
+  }
+
+ private:
+  const std::uint64_t key;
+};
+
+std::uint64_t point_key(unsigned int seed, const double* theta, int ndim) {
+  // identity of a point is the bit pattern of its coordinates
+
+  std::uint64_t key = mix(seed);
+
+  for (int i = 0; i < ndim; i++) {
+    std::uint64_t bits;
+    std::memcpy(&bits, theta + i, sizeof(bits));
+    key = mix(key ^ mix(bits + (i + 1) * GAMMA));
+  }
+
+  return key;
+}
+
+unsigned int point_seed(unsigned int seed, const double* theta, int ndim) {
+  return static_cast<unsigned int>(Stream(point_key(seed, theta, ndim))(0)
+                                   >> 32);
+}
+
+}  // end namespace rng
+}  // end namespace polystan
+
+#endif  // POLYSTAN_RNG_HPP_
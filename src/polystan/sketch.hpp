@@ -0,0 +1,199 @@
+#ifndef POLYSTAN_SKETCH_HPP_
+#define POLYSTAN_SKETCH_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "polystan/mpi.hpp"
+
+namespace polystan {
+namespace sketch {
+
+class TDigest {
+  // weighted quantile sketch of bounded size that can be merged with others.
+  // points are buffered and then merged into centroids, whose sizes are
+  // limited by the k1 scale function so that the tails are resolved finely.
+  // see arXiv:1902.04023
+
+ public:
+  explicit TDigest(double compression = 200.) : compression(compression) {}
+
+  void add(double x, double w = 1.) {
+    if (!(w > 0.) || std::isnan(x)) {
+      return;
+    }
+    if (buffer.capacity() == 0) {
+      // only once points are added, as there may be many sketches
+      buffer.reserve(buffer_size());
+    }
+    buffer.push_back({x, w});
+    if (buffer.size() >= buffer_size()) {
+      compress();
+    }
+  }
+
+  void merge(const TDigest& other) {
+    for (const auto* points : {&other.centroids, &other.buffer}) {
+      for (const auto& point : *points) {
+        add(point.mean, point.weight);
+      }
+    }
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+  }
+
+  double quantile(double q) {
+    compress();
+
+    if (centroids.empty()) {
+      return NAN;
+    }
+
+    if (centroids.size() == 1) {
+      return centroids[0].mean;
+    }
+
+    const double target = std::clamp(q, 0., 1.) * total;
+    const Centroid& first = centroids.front();
+    const Centroid& last = centroids.back();
+
+    if (target < 0.5 * first.weight) {
+      return min + (first.mean - min) * target / (0.5 * first.weight);
+    }
+
+    if (target > total - 0.5 * last.weight) {
+      return last.mean
+             + (max - last.mean) * (target - total + 0.5 * last.weight)
+                   / (0.5 * last.weight);
+    }
+
+    // interpolate between the centers of neighbouring centroids
+
+    double center = 0.5 * first.weight;
+    for (int i = 0; i + 1 < centroids.size(); i++) {
+      const double next
+          = center + 0.5 * (centroids[i].weight + centroids[i + 1].weight);
+      if (target <= next) {
+        const double t = (target - center) / (next - center);
+        return centroids[i].mean
+               + t * (centroids[i + 1].mean - centroids[i].mean);
+      }
+      center = next;
+    }
+
+    return last.mean;
+  }
+
+  std::size_t size() {
+    compress();
+    return centroids.size();
+  }
+
+  std::vector<double> serialize() {
+    // pairs of mean and weight, with the range marked by zero weights, so
+    // that serialized sketches can be concatenated
+
+    compress();
+    std::vector<double> data;
+    if (!centroids.empty()) {
+      data.insert(data.end(), {min, 0., max, 0.});
+    }
+    for (const auto& centroid : centroids) {
+      data.push_back(centroid.mean);
+      data.push_back(centroid.weight);
+    }
+    return data;
+  }
+
+  void merge_serialized(const std::vector<double>& data) {
+    for (int i = 0; i + 1 < data.size(); i += 2) {
+      if (data[i + 1] == 0.) {
+        min = std::min(min, data[i]);
+        max = std::max(max, data[i]);
+      } else {
+        add(data[i], data[i + 1]);
+      }
+    }
+  }
+
+  void gather() {
+    // merge this sketch from every process on rank zero
+
+    const auto data = mpi::gather(serialize());
+    if (mpi::is_rank_zero()) {
+      *this = TDigest(compression);
+      merge_serialized(data);
+    }
+  }
+
+ private:
+  struct Centroid {
+    double mean;
+    double weight;
+
+    bool operator<(const Centroid& other) const { return mean < other.mean; }
+  };
+
+  std::size_t buffer_size() const {
+    return 5 * static_cast<std::size_t>(compression);
+  }
+
+  double q_to_k(double q) const {
+    return compression / (2. * M_PI) * std::asin(2. * q - 1.);
+  }
+
+  double k_to_q(double k) const {
+    const double k_max = 0.25 * compression;
+    return 0.5 * (std::sin(std::min(k, k_max) * 2. * M_PI / compression) + 1.);
+  }
+
+  void compress() {
+    if (buffer.empty()) {
+      return;
+    }
+
+    for (const auto& point : buffer) {
+      total += point.weight;
+      min = std::min(min, point.mean);
+      max = std::max(max, point.mean);
+    }
+
+    buffer.insert(buffer.end(), centroids.begin(), centroids.end());
+    std::sort(buffer.begin(), buffer.end());
+    centroids.clear();
+
+    Centroid current = buffer[0];
+    double so_far = 0.;
+    double limit = k_to_q(q_to_k(0.) + 1.) * total;
+
+    for (int i = 1; i < buffer.size(); i++) {
+      const Centroid& point = buffer[i];
+      if (so_far + current.weight + point.weight <= limit) {
+        current.weight += point.weight;
+        current.mean += (point.mean - current.mean) * point.weight
+                        / current.weight;
+      } else {
+        so_far += current.weight;
+        centroids.push_back(current);
+        limit = k_to_q(q_to_k(so_far / total) + 1.) * total;
+        current = point;
+      }
+    }
+
+    centroids.push_back(current);
+    buffer.clear();
+  }
+
+  double compression;
+  double total = 0.;
+  double min = INFINITY;
+  double max = -INFINITY;
+  std::vector<Centroid> centroids;
+  std::vector<Centroid> buffer;
+};
+
+}  // end namespace sketch
+}  // end namespace polystan
+
+#endif  // POLYSTAN_SKETCH_HPP_
@@ -1,14 +1,18 @@
 #ifndef POLYSTAN_SPLASH_HPP_
 #define POLYSTAN_SPLASH_HPP_
 
+#include <array>
+#include <optional>
 #include <regex>
 #include <string>
 #include <sstream>
 #include <vector>
 
 #include "polystan/version.hpp"
+#include "polystan/async.hpp"
 #include "polystan/model.hpp"
 #include "polystan/mpi.hpp"
+#include "polystan/timing.hpp"
 
 namespace polystan {
 namespace splash {
@@ -57,47 +61,80 @@ std::string start(const Model& model, const std::string& toml_file_name) {
   splash << PREFIX << "\n"
 #ifdef USE_MPI
          << PREFIX << "Using MPI with size: " << mpi::get_size() << "\n"
+         << PREFIX << "Synchronous workers: " << std::boolalpha
+         << model.synchronous() << "\n"
 #else
          << PREFIX << "Not compiled with MPI" << "\n"
 #endif
-         << PREFIX << "\n"
-         << PREFIX << "Running PolyChord\n"
+         << PREFIX << "\n";
+
+  const auto timing = model.timing();
+
+  if (timing.has_value()) {
+    splash << PREFIX << "Likelihood evaluation time: " << timing->mean()
+           << " ± " << timing->sd() << " s from " << timing->count()
+           << " prior draws\n"
+           << PREFIX << "\n";
+  }
+
+  splash << PREFIX << "Running PolyChord\n"
          << RESET;
 
   return splash.str();
 }
 
-std::string end(const std::string& json_file_name, const Model& model) {
+std::string end(const std::string& json_file_name,
+                const std::string& native_file_names, const Model& model,
+                const Results& results, const async::Report& written) {
   std::stringstream splash;
-  const auto p_value = model.p_value();
-  const auto ess = model.ess();
-  const auto evidence = model.evidence();
 
   splash << COLOR << "\n"
          << PREFIX << "Finished PolyChord\n"
-         << PREFIX << "Native PolyChord results at " << model.basename()
-         << "*\n"
+         << PREFIX << "Native PolyChord results at " << native_file_names
+         << "\n"
          << PREFIX << "PolyStan JSON summary at " << json_file_name << "\n";
 
-  if (evidence.has_value() || p_value.has_value() || ess.has_value()) {
+  if (results.evidence.has_value() || results.p_value.has_value()
+      || results.ess.has_value()) {
     splash << PREFIX << "\n";
   }
 
-  if (evidence.has_value()) {
-    const auto [logz, err] = evidence.value();
+  if (results.evidence.has_value()) {
+    const auto [logz, err] = results.evidence.value();
     splash << PREFIX << "Evidence log(Z) = " << logz << " ± " << err << "\n";
   }
 
-  if (p_value.has_value()) {
-    splash << PREFIX
-           << "P-value of sampling from constrained prior = " << p_value.value()
+  if (results.p_value.has_value()) {
+    splash << PREFIX << "P-value of sampling from constrained prior = "
+           << results.p_value.value() << "\n";
+  }
+
+  if (results.ess.has_value()) {
+    splash << PREFIX << "Effective number of samples = "
+           << results.ess.value() << "\n";
+  }
+
+  splash << PREFIX << "\n"
+         << PREFIX << "Likelihood evaluations per process = "
+         << results.load_balance.neval << "\n"
+         << PREFIX << "Efficiency = " << results.load_balance.efficiency()
+         << "\n";
+
+  if (results.load_balance.neval.size() > 1) {
+    splash << PREFIX << "Imbalance = " << results.load_balance.imbalance()
            << "\n";
   }
 
-  if (ess.has_value()) {
-    splash << PREFIX << "Effective number of samples = " << ess.value() << "\n";
+  if (results.load_balance.master_saturation().has_value()) {
+    splash << PREFIX << "Master saturation = "
+           << results.load_balance.master_saturation().value() << "\n";
   }
 
+  splash << PREFIX << "\n"
+         << PREFIX << "Wrote " << written.bytes / 1e6 << " MB of outputs in "
+         << written.write_time << " s, waiting " << written.stall_time
+         << " s for the writer (" << written.avoided() << " s saved)\n";
+
   splash << PREFIX << "\n"
          << PREFIX << "If you use these results, you are required to cite\n"
          << PREFIX << "https://arxiv.org/abs/1502.01856\n"
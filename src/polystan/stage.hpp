@@ -0,0 +1,162 @@
+#ifndef POLYSTAN_STAGE_HPP_
+#define POLYSTAN_STAGE_HPP_
+
+#include <signal.h>
+
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace polystan {
+namespace stage {
+
+namespace fs = std::filesystem;
+
+bool replace(const fs::path& from, const fs::path& to) {
+  // copy to a hidden file beside to and rename it over to, so that readers
+  // of to never see part of a file. false if from changed while copying
+
+  const auto size = fs::file_size(from);
+  const auto time = fs::last_write_time(from);
+  const fs::path part = to.parent_path() / ("." + to.filename().string()
+                                            + ".part");
+
+  fs::create_directories(to.parent_path());
+  fs::copy_file(from, part, fs::copy_options::overwrite_existing);
+
+  if (fs::file_size(from) != size || fs::last_write_time(from) != time) {
+    fs::remove(part);
+    return false;
+  }
+
+  fs::rename(part, to);
+  return true;
+}
+
+void flush(const fs::path& local, const fs::path& remote) {
+  // copy every file of a staging directory, e.g., of another process, and
+  // remove it. files that change while copying are skipped
+
+  try {
+    for (const auto& entry : fs::recursive_directory_iterator(local)) {
+      if (entry.is_regular_file()) {
+        replace(entry.path(), remote / entry.path().lexically_relative(local));
+      }
+    }
+  } catch (...) {
+    // e.g., removed by its own process meanwhile
+  }
+
+  std::error_code error;
+  fs::remove_all(local, error);
+}
+
+bool alive(int pid) {
+  // whether a process exists on this node
+  return ::kill(pid, 0) == 0 || errno == EPERM;
+}
+
+class Stager {
+  // files are written to a local directory and copied to a remote one on a
+  // dedicated thread whenever they have changed, and once more when
+  // finished, after which the local directory is removed
+
+ public:
+  Stager(const fs::path& local_, const fs::path& remote_, double interval)
+      : local(local_), remote(remote_) {
+    fs::create_directories(local);
+    thread = std::thread([this, interval]() {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (!stop.wait_for(lock, std::chrono::duration<double>(interval),
+                            [this]() { return stopping; })) {
+        lock.unlock();
+        try {
+          sync();
+        } catch (...) {
+          // e.g., a file removed while copying; tried again next time
+        }
+        lock.lock();
+      }
+    });
+  }
+
+  Stager(const Stager&) = delete;
+  Stager& operator=(const Stager&) = delete;
+
+  ~Stager() {
+    try {
+      finish();
+    } catch (...) {
+    }
+  }
+
+  void stage_in(const fs::path& file_name) {
+    // copy a remote file, e.g., to resume from, to the local directory
+    const fs::path to = local / file_name.lexically_relative(remote);
+    fs::create_directories(to.parent_path());
+    fs::copy_file(file_name, to, fs::copy_options::overwrite_existing);
+  }
+
+  void finish() {
+    // copy everything that remains and remove the local directory
+
+    if (!thread.joinable()) {
+      return;
+    }
+
+    {
+      const std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    stop.notify_one();
+    thread.join();
+
+    sync();
+    fs::remove_all(local);
+  }
+
+ private:
+  void sync() {
+    // copy files that have changed since they were last copied
+
+    for (const auto& entry : fs::recursive_directory_iterator(local)) {
+      if (!entry.is_regular_file()) {
+        continue;
+      }
+
+      const fs::path relative = entry.path().lexically_relative(local);
+      const auto state
+          = std::make_pair(entry.file_size(), entry.last_write_time());
+      const auto it = copied.find(relative);
+
+      if (it != copied.end() && it->second == state) {
+        continue;
+      }
+
+      if (replace(entry.path(), remote / relative)) {
+        copied[relative] = state;
+      }
+    }
+  }
+
+  const fs::path local;
+  const fs::path remote;
+  std::map<fs::path, std::pair<std::uintmax_t, fs::file_time_type>> copied;
+  std::mutex mutex;
+  std::condition_variable stop;
+  bool stopping = false;
+  std::thread thread;
+};
+
+}  // end namespace stage
+}  // end namespace polystan
+
+#endif  // POLYSTAN_STAGE_HPP_
@@ -0,0 +1,190 @@
+#ifndef POLYSTAN_SUMMARY_HPP_
+#define POLYSTAN_SUMMARY_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "polystan/json.hpp"
+#include "polystan/merge.hpp"
+#include "polystan/mpi.hpp"
+#include "polystan/sketch.hpp"
+#include "polystan/variables.hpp"
+
+namespace polystan {
+namespace summary {
+
+const std::vector<double> QUANTILES{0.05, 0.5, 0.95};
+
+struct Stats {
+  double mean;
+  double sd;
+  std::vector<double> quantiles;
+  double ess;  // for the weighted mean of this parameter
+};
+
+std::vector<double> weights(const std::vector<double>& death,
+                            const std::vector<double>& birth) {
+  // normalized posterior weights of dead points in their original order
+
+  std::vector<int> order(death.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(),
+            [&](int i, int j) -> bool { return death[i] < death[j]; });
+
+  std::vector<double> sorted_death(death.size());
+  std::vector<double> sorted_birth(birth.size());
+  for (int i = 0; i < order.size(); i++) {
+    sorted_death[i] = death[order[i]];
+    sorted_birth[i] = birth[order[i]];
+  }
+
+  const auto log_w = merge::log_weights(sorted_death, sorted_birth);
+  const double logz = merge::logsumexp(log_w);
+
+  std::vector<double> w(death.size());
+  for (int i = 0; i < order.size(); i++) {
+    w[order[i]] = std::exp(log_w[i] - logz);
+  }
+  return w;
+}
+
+std::string percent(double q) {
+  char label[16];
+  std::snprintf(label, sizeof(label), "%g%%", 100. * q);
+  return label;
+}
+
+class Moments {
+  // weighted mean and standard deviation of a parameter, and the variance of
+  // its weighted mean, from points added one at a time and merged between
+  // threads and processes. squared deviations are summed about running means,
+  // as in Welford's algorithm, once with weights and once with squared
+  // weights
+
+ public:
+  void add(double x, double w) {
+    if (!(w > 0.) || std::isnan(x)) {
+      return;
+    }
+    by_weight.add(x, w, 0.);
+    by_weight_squared.add(x, w * w, 0.);
+  }
+
+  void merge(const Moments& other) {
+    by_weight.add(other.by_weight.mean, other.by_weight.weight,
+                  other.by_weight.m2);
+    by_weight_squared.add(other.by_weight_squared.mean,
+                          other.by_weight_squared.weight,
+                          other.by_weight_squared.m2);
+  }
+
+  void gather() {
+    // merge these moments from every process on rank zero
+
+    const auto data = mpi::gather(std::vector<double>{
+        by_weight.weight, by_weight.mean, by_weight.m2,
+        by_weight_squared.weight, by_weight_squared.mean,
+        by_weight_squared.m2});
+
+    if (mpi::is_rank_zero()) {
+      *this = Moments();
+      for (int i = 0; i + 5 < data.size(); i += 6) {
+        by_weight.add(data[i + 1], data[i], data[i + 2]);
+        by_weight_squared.add(data[i + 4], data[i + 3], data[i + 5]);
+      }
+    }
+  }
+
+  Stats stats(sketch::TDigest& sketch) const {
+    // quantiles are found from a sketch of the same points
+
+    Stats stats;
+    const double total = by_weight.weight;
+    stats.mean = total > 0. ? by_weight.mean : NAN;
+
+    const double var = total > 0. ? by_weight.m2 / total : NAN;
+    stats.sd = std::sqrt(var);
+
+    // squared weights times squared deviations from the weighted mean, from
+    // those about the mean weighted by squared weights
+    const double shift = by_weight_squared.mean - by_weight.mean;
+    const double var_mean
+        = total > 0. ? (by_weight_squared.m2
+                        + by_weight_squared.weight * shift * shift)
+                           / (total * total)
+                     : 0.;
+
+    // as var / ess is the variance of the weighted mean; with equal weights
+    // this is the number of samples
+    stats.ess = var_mean > 0. ? var / var_mean : 0.;
+
+    for (const double q : QUANTILES) {
+      stats.quantiles.push_back(sketch.quantile(q));
+    }
+
+    return stats;
+  }
+
+ private:
+  struct Welford {
+    double weight = 0.;
+    double mean = 0.;
+    double m2 = 0.;  // weighted sum of squared deviations from mean
+
+    void add(double x, double w, double x_m2) {
+      // a point, or a merged set of points with mean x
+      if (!(w > 0.)) {
+        return;
+      }
+      const double total = weight + w;
+      const double delta = x - mean;
+      mean += delta * w / total;
+      m2 += x_m2 + delta * delta * weight * w / total;
+      weight = total;
+    }
+  };
+
+  Welford by_weight;
+  Welford by_weight_squared;
+};
+
+void add(json::Object& object,
+         const std::vector<variables::Variable>& variables,
+         const std::vector<Stats>& stats) {
+  // stats of each parameter, following log-likelihood in columns, as arrays
+  // of the shape of its variable
+
+  for (const auto& variable : variables) {
+    if (variable.begin == 0
+        || variable.begin + variable.size() > stats.size() + 1) {
+      continue;
+    }
+
+    auto stat = [&](auto f) {
+      return variables::arrange(
+          variable, [&](int column) { return f(stats[column - 1]); });
+    };
+
+    json::Object entry;
+    auto mean = stat([](const Stats& s) { return s.mean; });
+    entry.add("mean", mean, variable.shape);
+    auto sd = stat([](const Stats& s) { return s.sd; });
+    entry.add("sd", sd, variable.shape);
+    for (int k = 0; k < QUANTILES.size(); k++) {
+      auto quantile = stat([&](const Stats& s) { return s.quantiles[k]; });
+      entry.add(percent(QUANTILES[k]), quantile, variable.shape);
+    }
+    auto ess = stat([](const Stats& s) { return s.ess; });
+    entry.add("ess", ess, variable.shape);
+    object.add(variable.name, entry);
+  }
+}
+
+}  // end namespace summary
+}  // end namespace polystan
+
+#endif  // POLYSTAN_SUMMARY_HPP_
@@ -31,12 +31,174 @@ void sort_by_birth(std::vector<double>& death, std::vector<double>& birth) {
   std::sort(birth.begin(), birth.end());
 }
 
-std::vector<int> insertion_indexes(const std::vector<double>& death,
-                                   const std::vector<double>& birth) {
+class Fenwick {
+  // counts with O(log n) update and prefix sum
+
+ public:
+  Fenwick() = default;
+
+  explicit Fenwick(const std::vector<int>& counts) : tree(counts) {
+    // build in O(n)
+    for (int i = 0; i < tree.size(); ++i) {
+      const int j = i | (i + 1);
+      if (j < tree.size()) {
+        tree[j] += tree[i];
+      }
+    }
+  }
+
+  void add(int i) {
+    for (; i < tree.size(); i |= i + 1) {
+      tree[i]++;
+    }
+  }
+
+  void push_back(int count) {
+    // node i holds the sum over [i & (i + 1), i]
+    const int i = tree.size();
+    tree.push_back(count + prefix(i) - prefix(i & (i + 1)));
+  }
+
+  int size() const { return tree.size(); }
+
+  int prefix(int end) const {
+    // sum of counts before end
+    int sum = 0;
+    for (int i = end - 1; i >= 0; i = (i & (i + 1)) - 1) {
+      sum += tree[i];
+    }
+    return sum;
+  }
+
+ private:
+  std::vector<int> tree;
+};
+
+class Sweep {
+  // insertion indexes by sweeping up through birth contours. points born at
+  // or below a contour are added to a Fenwick tree of deaths, from which we
+  // count deaths between the birth and death of a point, in O(n log n)
+
+ public:
+  Sweep(const std::vector<double>& death, const std::vector<double>& birth)
+      : birth(birth), order(birth.size()), sorted_death(death),
+        rank(death.size()) {
+    std::iota(order.begin(), order.end(), 0);
+    if (!std::is_sorted(birth.begin(), birth.end())) {
+      std::stable_sort(order.begin(), order.end(), [&](int i, int j) -> bool {
+        return birth[i] < birth[j];
+      });
+    }
+
+    std::sort(sorted_death.begin(), sorted_death.end());
+
+    for (int i = 0; i < death.size(); ++i) {
+      rank[i] = std::lower_bound(sorted_death.begin(), sorted_death.end(),
+                                 death[i])
+                - sorted_death.begin();
+    }
+  }
+
+  std::vector<int> operator()(int begin, int end) const {
+    // indexes of points begin to end in order of birth
+
+    std::vector<int> indexes;
+
+    if (begin >= end) {
+      return indexes;
+    }
+
+    // start from points born at or below first contour
+
+    int added = upper_bound(birth[order[begin]]);
+    std::vector<int> counts(sorted_death.size(), 0);
+    for (int k = 0; k < added; ++k) {
+      counts[rank[order[k]]]++;
+    }
+    Fenwick tree(counts);
+
+    for (int k = begin; k < end; ++k) {
+      const int i = order[k];
+
+      for (; added < order.size() && birth[order[added]] <= birth[i]; ++added) {
+        tree.add(rank[order[added]]);
+      }
+
+      const int above
+          = std::upper_bound(sorted_death.begin(), sorted_death.end(),
+                             birth[i])
+            - sorted_death.begin();
+      indexes.push_back(
+          std::max(tree.prefix(rank[i]) - tree.prefix(above), 0));
+    }
+
+    return indexes;
+  }
+
+  const std::vector<int>& birth_order() const { return order; }
+
+ private:
+  int upper_bound(double contour) const {
+    return std::upper_bound(
+               order.begin(), order.end(), contour,
+               [&](double value, int i) -> bool { return value < birth[i]; })
+           - order.begin();
+  }
+
+  const std::vector<double>& birth;
+  std::vector<int> order;
+  std::vector<double> sorted_death;
+  std::vector<int> rank;
+};
+
+class Online {
+  // insertion indexes of points as they die. deaths arrive in increasing
+  // order and every birth contour is an earlier death, so the index of a
+  // point is the number of earlier points born at or below its birth, minus
+  // the number that died at or below it. points born are counted in a
+  // Fenwick tree keyed by the number of deaths below their birth
+
+ public:
+  Online() : born(std::vector<int>(1, 0)) {}
+
+  int add(double death, double birth) {
+    const int below = std::upper_bound(deaths.begin(), deaths.end(), birth)
+                      - deaths.begin();
+    int index = born.prefix(below + 1) - below;
+
+    // earlier points that died at the same contour are not below this one
+
+    if (deaths.empty() || deaths.back() != death) {
+      tied.clear();
+    } else if (death > birth) {
+      index -= std::upper_bound(tied.begin(), tied.end(), birth) - tied.begin();
+    }
+    tied.insert(std::upper_bound(tied.begin(), tied.end(), birth), birth);
+
+    deaths.push_back(death);
+    born.push_back(0);
+    born.add(below);
+
+    return index;
+  }
+
+  int size() const { return deaths.size(); }
+
+ private:
+  std::vector<double> deaths;
+  std::vector<double> tied;  // sorted births of points dying at last death
+  Fenwick born;
+};
+
+std::vector<int> insertion_indexes_brute_force(
+    const std::vector<double>& death, const std::vector<double>& birth,
+    int begin, int end) {
+  // O(n^2) reference implementation
+
   std::vector<int> indexes;
   const int sample_size = birth.size();
 
-  for (int i = 0; i < sample_size; ++i) {
+  for (int i = begin; i < end; ++i) {
     int idx = 0;
 
     for (int j = 0; j < sample_size; ++j) {
@@ -51,6 +213,33 @@ std::vector<int> insertion_indexes(const std::vector<double>& death,
   return indexes;
 }
 
+std::vector<int> insertion_indexes(const std::vector<double>& death,
+                                   const std::vector<double>& birth,
+                                   int begin, int end) {
+  // indexes of points begin to end
+
+  const Sweep sweep(death, birth);
+
+  if (std::is_sorted(birth.begin(), birth.end())) {
+    return sweep(begin, end);
+  }
+
+  const std::vector<int> sorted = sweep(0, birth.size());
+  const std::vector<int>& order = sweep.birth_order();
+  std::vector<int> indexes(birth.size());
+
+  for (int k = 0; k < order.size(); ++k) {
+    indexes[order[k]] = sorted[k];
+  }
+
+  return std::vector<int>(indexes.begin() + begin, indexes.begin() + end);
+}
+
+std::vector<int> insertion_indexes(const std::vector<double>& death,
+                                   const std::vector<double>& birth) {
+  return insertion_indexes(death, birth, 0, birth.size());
+}
+
 std::vector<double> empirical_cmf(const std::vector<int>& indexes, int nlive) {
   std::vector<double> pmf(nlive + 1, 0.);
   const int n = indexes.size();
@@ -89,46 +278,129 @@ double insertion_index_p_value(const std::string& death_birth_file_name,
   return insertion_index_p_value(indexes, nlive);
 }
 
-std::vector<std::vector<int>> split(const std::vector<int>& data,
-                                    int part_size) {
-  std::vector<std::vector<int>> parts;
+std::vector<int> batch_bounds(int total_size, int part_size) {
+  // start of each batch and end of last batch
 
-  const int total_size = data.size();
   const int remainder = total_size % part_size;
   const int n = total_size / part_size;
 
-  int start = 0;
+  std::vector<int> bounds = {0};
 
   for (int i = 0; i < n; ++i) {
-    size_t current_part_size = part_size + (i < remainder ? 1 : 0);
-    std::vector<int> part(data.begin() + start,
-                          data.begin() + start + current_part_size);
-    parts.push_back(part);
-    start += current_part_size;
+    bounds.push_back(bounds.back() + part_size + (i < remainder ? 1 : 0));
+  }
+
+  return bounds;
+}
+
+std::vector<std::vector<int>> split(const std::vector<int>& data,
+                                    int part_size) {
+  std::vector<std::vector<int>> parts;
+  const std::vector<int> bounds = batch_bounds(data.size(), part_size);
+
+  for (int i = 0; i + 1 < bounds.size(); ++i) {
+    parts.emplace_back(data.begin() + bounds[i], data.begin() + bounds[i + 1]);
   }
 
   return parts;
 }
 
-double insertion_index_p_value(const std::string& death_birth_file_name,
-                               int nlive, int batch) {
+std::vector<double> batch_p_values(const std::vector<double>& death,
+                                   const std::vector<double>& birth,
+                                   int nlive, int batch, int part, int nparts,
+                                   int nthreads = 0) {
+  // p-values of the batches in part of nparts. death and birth must be sorted
+  // by birth. threads sweep through consecutive shares of the batches
+
+  const std::vector<int> bounds = batch_bounds(birth.size(), batch * nlive);
+  const int nbatches = bounds.size() - 1;
+  const int first = nbatches * part / nparts;
+  const int last = nbatches * (part + 1) / nparts;
+
+  std::vector<double> p_values(last - first);
+
+  if (p_values.empty()) {
+    return p_values;
+  }
+
+  if (nthreads <= 0) {
+    nthreads = read::default_threads();
+  }
+  nthreads = std::min<int>(nthreads, p_values.size());
+
+  const Sweep sweep(death, birth);
+
+  read::parallel(nthreads, [&](int k) {
+    const int begin = first + (last - first) * k / nthreads;
+    const int end = first + (last - first) * (k + 1) / nthreads;
+    const std::vector<int> indexes = sweep(bounds[begin], bounds[end]);
+
+    for (int i = begin; i < end; ++i) {
+      const std::vector<int> batch_indexes(
+          indexes.begin() + bounds[i] - bounds[begin],
+          indexes.begin() + bounds[i + 1] - bounds[begin]);
+      p_values[i - first] = insertion_index_p_value(batch_indexes, nlive);
+    }
+  });
+
+  return p_values;
+}
+
+double combine_p_values(double min_p_value, int nbatches) {
+  return 1. - std::pow(1. - min_p_value, nbatches);
+}
+
+double insertion_index_p_value(std::vector<double> death,
+                               std::vector<double> birth, int nlive,
+                               int batch) {
   if (batch == 0) {
-    return insertion_index_p_value(death_birth_file_name, nlive);
+    return insertion_index_p_value(insertion_indexes(death, birth), nlive);
   }
 
-  auto [death, birth] = read::death_birth(death_birth_file_name);
   sort_by_birth(death, birth);
 
-  const std::vector<int> indexes = insertion_indexes(death, birth);
-  const std::vector<std::vector<int>> batches = split(indexes, batch * nlive);
+  const std::vector<double> p_values
+      = batch_p_values(death, birth, nlive, batch, 0, 1);
+  const double p_value
+      = std::accumulate(p_values.begin(), p_values.end(), 1.,
+                        [](double a, double b) { return std::min(a, b); });
+
+  return combine_p_values(p_value, p_values.size());
+}
 
+double batched_p_value(const std::vector<int>& indexes,
+                       const std::vector<double>& birth, int nlive,
+                       int batch) {
+  // from indexes already found, e.g., online. batches are in order of birth
+
+  if (batch == 0) {
+    return insertion_index_p_value(indexes, nlive);
+  }
+
+  std::vector<int> order(birth.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](int i, int j) -> bool {
+    return birth[i] < birth[j];
+  });
+
+  const std::vector<int> bounds = batch_bounds(birth.size(), batch * nlive);
   double p_value = 1.;
 
-  for (const auto& b : batches) {
-    p_value = std::min(p_value, insertion_index_p_value(b, nlive));
+  for (int i = 0; i + 1 < bounds.size(); ++i) {
+    std::vector<int> batch_indexes;
+    for (int k = bounds[i]; k < bounds[i + 1]; ++k) {
+      batch_indexes.push_back(indexes[order[k]]);
+    }
+    p_value = std::min(p_value, insertion_index_p_value(batch_indexes, nlive));
   }
 
-  return 1. - std::pow(1. - p_value, batches.size());
+  return combine_p_values(p_value, bounds.size() - 1);
+}
+
+double insertion_index_p_value(const std::string& death_birth_file_name,
+                               int nlive, int batch) {
+  auto [death, birth] = read::death_birth(death_birth_file_name);
+  return insertion_index_p_value(death, birth, nlive, batch);
 }
 
 }  // end namespace test
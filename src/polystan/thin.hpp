@@ -0,0 +1,78 @@
+#ifndef POLYSTAN_THIN_HPP_
+#define POLYSTAN_THIN_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace polystan {
+namespace thin {
+
+struct Options {
+  int factor = 1;                // keep one in factor samples
+  std::int64_t max_samples = 0;  // in total; if 0, no maximum
+
+  bool enabled() const { return factor > 1 || max_samples > 0; }
+
+  std::int64_t keep(std::int64_t total, int file, int nfiles) const {
+    // number of samples kept from a file of total samples, sharing the
+    // maximum among files
+
+    std::int64_t n = (total + factor - 1) / factor;
+    if (max_samples > 0) {
+      const std::int64_t share
+          = max_samples / nfiles + (file < max_samples % nfiles);
+      n = std::min(n, share);
+    }
+    return std::min(n, total);
+  }
+};
+
+struct Counts {
+  std::int64_t available = 0;
+  std::int64_t kept = 0;
+};
+
+std::int64_t position(std::int64_t i, std::int64_t total, std::int64_t keep,
+                      double u) {
+  // of the ith of keep samples chosen systematically from total, starting
+  // from a uniform offset u
+  return static_cast<std::int64_t>((i + u) * total / keep);
+}
+
+std::vector<std::int64_t> systematic(std::int64_t total, std::int64_t keep,
+                                     double u, std::int64_t begin,
+                                     std::int64_t end) {
+  // positions in [begin, end) of keep samples chosen systematically from
+  // total. equally weighted samples remain so
+
+  std::vector<std::int64_t> kept;
+
+  if (keep <= 0 || begin >= end) {
+    return kept;
+  }
+
+  // first i whose position could be at or after begin
+  std::int64_t i = std::max<std::int64_t>(
+      static_cast<std::int64_t>(std::floor(
+          static_cast<double>(begin) * keep / total - u)),
+      0);
+
+  for (; i < keep; i++) {
+    const std::int64_t p = position(i, total, keep, u);
+    if (p >= end) {
+      break;
+    }
+    if (p >= begin) {
+      kept.push_back(p);
+    }
+  }
+
+  return kept;
+}
+
+}  // end namespace thin
+}  // end namespace polystan
+
+#endif  // POLYSTAN_THIN_HPP_
@@ -0,0 +1,152 @@
+#ifndef POLYSTAN_TIMING_HPP_
+#define POLYSTAN_TIMING_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <optional>
+#include <vector>
+
+#include "polystan/mpi.hpp"
+
+namespace polystan {
+namespace timing {
+
+class Timer {
+ public:
+  Timer() : start(std::chrono::steady_clock::now()) {}
+
+  double elapsed() const {
+    const std::chrono::duration<double> duration
+        = std::chrono::steady_clock::now() - start;
+    return duration.count();
+  }
+
+ private:
+  std::chrono::steady_clock::time_point start;
+};
+
+class Stats {
+ public:
+  void add(double x) {
+    n += 1;
+    sum += x;
+    sum2 += x * x;
+  }
+
+  Stats allreduce() const {
+    Stats global;
+    global.n = mpi::sum(n);
+    global.sum = mpi::sum(sum);
+    global.sum2 = mpi::sum(sum2);
+    return global;
+  }
+
+  int count() const { return n; }
+
+  double mean() const { return sum / n; }
+
+  double sd() const {
+    if (n < 2) {
+      return 0.;
+    }
+    const double var = (sum2 - sum * sum / n) / (n - 1);
+    return std::sqrt(std::max(var, 0.));
+  }
+
+  double cv() const { return sd() / mean(); }
+
+ private:
+  int n = 0;
+  double sum = 0.;
+  double sum2 = 0.;
+};
+
+struct Counter {
+  std::int64_t n = 0;
+  double busy = 0.;
+  double wall = 0.;
+};
+
+struct LoadBalance {
+  // per process likelihood evaluations, time spent in likelihood and time
+  // spent running PolyChord
+
+  std::vector<std::int64_t> neval;
+  std::vector<double> busy;
+  std::vector<double> wall;
+  std::vector<int> master;
+
+  std::vector<int> workers() const {
+    std::vector<int> index;
+    for (int i = 0; i < master.size(); i++) {
+      if (!master[i]) {
+        index.push_back(i);
+      }
+    }
+    return index;
+  }
+
+  // ratios are zero rather than NaN if nothing was timed, e.g., if a
+  // resumed run made no evaluations
+
+  double efficiency() const {
+    const double total_wall = std::accumulate(wall.begin(), wall.end(), 0.);
+    if (total_wall <= 0.) {
+      return 0.;
+    }
+    return std::accumulate(busy.begin(), busy.end(), 0.) / total_wall;
+  }
+
+  double imbalance() const {
+    double total = 0.;
+    double max = 0.;
+    for (const int& i : workers()) {
+      total += busy[i];
+      max = std::max(max, busy[i]);
+    }
+    if (total <= 0.) {
+      return 0.;
+    }
+    return max * workers().size() / total - 1.;
+  }
+
+  double idle() const {
+    double total_busy = 0.;
+    double total_wall = 0.;
+    for (const int& i : workers()) {
+      total_busy += busy[i];
+      total_wall += wall[i];
+    }
+    if (total_wall <= 0.) {
+      return 0.;
+    }
+    return 1. - total_busy / total_wall;
+  }
+
+  std::optional<double> master_saturation() const {
+    // even the busiest worker waits for work when a master is saturated.
+    // none if there is no master, e.g., in a serial run, or no worker was
+    // timed
+
+    if (std::none_of(master.begin(), master.end(),
+                     [](int m) { return m != 0; })) {
+      return std::nullopt;
+    }
+
+    std::optional<double> saturation;
+    for (const int& i : workers()) {
+      if (wall[i] > 0.) {
+        saturation = std::min(saturation.value_or(1.), 1. - busy[i] / wall[i]);
+      }
+    }
+    return saturation;
+  }
+};
+
+}  // end namespace timing
+}  // end namespace polystan
+
+#endif  // POLYSTAN_TIMING_HPP_
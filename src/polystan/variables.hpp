@@ -0,0 +1,150 @@
+#ifndef POLYSTAN_VARIABLES_HPP_
+#define POLYSTAN_VARIABLES_HPP_
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <vector>
+
+namespace polystan {
+namespace variables {
+
+struct Variable {
+  // consecutive columns that are elements of one array, e.g., x.1, x.2, ...
+
+  std::string name;
+  std::vector<int> shape;  // empty for scalars
+  int begin;               // first column
+  std::vector<int> offsets;  // row-major offset of each column in the array
+
+  int size() const { return offsets.size(); }
+};
+
+bool parse_indexes(const std::string& name, std::string& base,
+                   std::vector<int>& indexes) {
+  // split e.g. x.2.3 into x and 1, 2 zero-based; false if not indexed
+
+  const auto dot = name.find('.');
+  if (dot == std::string::npos || dot == 0) {
+    return false;
+  }
+
+  base = name.substr(0, dot);
+  indexes.clear();
+  std::size_t start = dot + 1;
+
+  while (true) {
+    const auto end = name.find('.', start);
+    const std::string token = name.substr(start, end - start);
+    if (token.empty() || token.size() > 9) {
+      return false;
+    }
+    for (const char c : token) {
+      if (!std::isdigit(static_cast<unsigned char>(c))) {
+        return false;
+      }
+    }
+    const int index = std::stoi(token);
+    if (index < 1) {
+      return false;
+    }
+    indexes.push_back(index - 1);
+    if (end == std::string::npos) {
+      return true;
+    }
+    start = end + 1;
+  }
+}
+
+Variable scalar(const std::string& name, int column) {
+  return {name, {}, column, {0}};
+}
+
+template <typename F>
+auto arrange(const Variable& variable, F f) {
+  // f(column) for each column of variable, in row-major order of its array
+
+  std::vector<int> columns(variable.size());
+  for (int k = 0; k < variable.size(); k++) {
+    columns[variable.offsets[k]] = variable.begin + k;
+  }
+
+  std::vector<decltype(f(0))> elements;
+  elements.reserve(columns.size());
+  for (const int column : columns) {
+    elements.push_back(f(column));
+  }
+  return elements;
+}
+
+std::vector<Variable> parse(const std::vector<std::string>& names,
+                            bool flat = false) {
+  // group columns into arrays. elements must be consecutive and fill their
+  // shape exactly once; otherwise they are kept as scalars
+
+  std::vector<Variable> variables;
+  int i = 0;
+
+  while (i < names.size()) {
+    std::string base;
+    std::vector<std::vector<int>> indexes(1);
+
+    if (flat || !parse_indexes(names[i], base, indexes[0])) {
+      variables.push_back(scalar(names[i], i));
+      i++;
+      continue;
+    }
+
+    int j = i + 1;
+    std::vector<int> next;
+    std::string next_base;
+    while (j < names.size() && parse_indexes(names[j], next_base, next)
+           && next_base == base && next.size() == indexes[0].size()) {
+      indexes.push_back(next);
+      j++;
+    }
+
+    std::vector<int> shape(indexes[0].size(), 0);
+    for (const auto& index : indexes) {
+      for (int d = 0; d < shape.size(); d++) {
+        shape[d] = std::max(shape[d], index[d] + 1);
+      }
+    }
+
+    std::size_t size = 1;
+    for (const int extent : shape) {
+      size *= extent;
+    }
+
+    std::vector<int> offsets;
+    std::vector<bool> seen(size == indexes.size() ? size : 0, false);
+    for (const auto& index : indexes) {
+      int offset = 0;
+      for (int d = 0; d < shape.size(); d++) {
+        offset = offset * shape[d] + index[d];
+      }
+      if (seen.empty() || seen[offset]) {
+        break;
+      }
+      seen[offset] = true;
+      offsets.push_back(offset);
+    }
+
+    if (offsets.size() == indexes.size()) {
+      variables.push_back({base, shape, i, offsets});
+    } else {
+      for (int k = i; k < j; k++) {
+        variables.push_back(scalar(names[k], k));
+      }
+    }
+
+    i = j;
+  }
+
+  return variables;
+}
+
+}  // end namespace variables
+}  // end namespace polystan
+
+#endif  // POLYSTAN_VARIABLES_HPP_
@@ -0,0 +1,196 @@
+#ifndef POLYSTAN_ZARR_HPP_
+#define POLYSTAN_ZARR_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "polystan/async.hpp"
+#include "polystan/json.hpp"
+#include "polystan/npy.hpp"
+
+namespace polystan {
+namespace zarr {
+
+// zarr v2 directory store. metadata is JSON and chunks are C-order bytes,
+// optionally gzip compressed, so no library beyond zlib is required
+
+template <typename T>
+std::string dtype();
+
+template <>
+std::string dtype<double>() {
+  return npy::little_endian() ? "<f8" : ">f8";
+}
+
+template <>
+std::string dtype<std::int64_t>() {
+  return npy::little_endian() ? "<i8" : ">i8";
+}
+
+class Store {
+ public:
+  Store(const std::string& dir_name, int chunk_size,
+        const json::Object& metadata, int level = 0)
+      : dir(dir_name), chunk_size(chunk_size), level(level), out(level) {
+    // every group carries the metadata as attributes
+    std::filesystem::create_directories(dir);
+    attrs.merge(metadata);
+    group("");
+  }
+
+  void group(const std::string& name,
+             const json::Object& extra = json::Object()) {
+    std::filesystem::create_directories(dir / name);
+
+    json::Object zgroup;
+    zgroup.add("zarr_format", 2);
+    write_metadata(path(name, ".zgroup"), zgroup);
+
+    json::Object zattrs;
+    zattrs.merge(attrs);
+    zattrs.merge(extra);
+    write_metadata(path(name, ".zattrs"), zattrs);
+  }
+
+  void missing(const std::string& name, const std::string& metadata) {
+    json::Object extra;
+    extra.add("metadata", metadata);
+    group(name, extra);
+  }
+
+  void coordinates(const std::string& group, std::int64_t ndraws) {
+    std::vector<std::int64_t> draw(ndraws);
+    std::iota(draw.begin(), draw.end(), 0);
+    array(group, "chain", std::vector<std::int64_t>{0}, {1}, {"chain"});
+    array(group, "draw", draw, {ndraws}, {"draw"});
+  }
+
+  void add(const std::string& group, const std::string& name,
+           const std::vector<double>& data, const std::vector<int>& shape) {
+    // C-order data of a variable of shape, with leading chain and draw
+    // dimensions. other dimensions are named as by arviz, e.g., x_dim_0
+
+    const std::int64_t size = std::accumulate(
+        shape.begin(), shape.end(), std::int64_t(1), std::multiplies<>());
+    std::vector<std::int64_t> shape_{1, std::int64_t(data.size()) / size};
+    std::vector<std::string> dimensions{"chain", "draw"};
+
+    for (int d = 0; d < shape.size(); d++) {
+      shape_.push_back(shape[d]);
+      dimensions.push_back(name + "_dim_" + std::to_string(d));
+    }
+
+    array(group, name, data, shape_, dimensions);
+  }
+
+  const async::Report& close() {
+    // consolidated metadata lets readers open the store in one read
+
+    json::Object zmetadata;
+    zmetadata.add("metadata", consolidated);
+    zmetadata.add("zarr_consolidated_format", 1);
+    zmetadata.write(dir / ".zmetadata");
+    return out.close();
+  }
+
+ private:
+  template <typename T>
+  void array(const std::string& group, const std::string& name,
+             const std::vector<T>& data,
+             const std::vector<std::int64_t>& shape,
+             const std::vector<std::string>& dimensions) {
+    // chunked along draws, i.e., the dimension after a leading chain
+    // dimension of length one, or else the first dimension
+
+    const std::string array_name = group.empty() ? name : group + "/" + name;
+    std::filesystem::create_directories(dir / array_name);
+
+    const int axis = dimensions.size() > 1 && dimensions[0] == "chain" ? 1 : 0;
+    const std::int64_t length = shape[axis];
+    const std::int64_t stride = length > 0 ? data.size() / length : 0;
+    const std::int64_t chunk = std::max<std::int64_t>(
+        std::min<std::int64_t>(chunk_size, length), 1);
+
+    for (std::int64_t start = 0, j = 0; start < length; start += chunk, j++) {
+      // edge chunks are stored at full size, padded with the fill value
+
+      std::vector<T> buffer(chunk * stride, fill<T>());
+      const std::int64_t end = std::min(start + chunk, length);
+      std::copy(data.begin() + start * stride, data.begin() + end * stride,
+                buffer.begin());
+
+      std::string key;
+      for (int d = 0; d < shape.size(); d++) {
+        key += (d > 0 ? "." : "") + std::to_string(d == axis ? j : 0);
+      }
+      const std::size_t bytes = buffer.size() * sizeof(T);
+      out.open(dir / array_name / key, bytes)
+          .write(reinterpret_cast<const char*>(buffer.data()), bytes);
+    }
+
+    std::vector<std::int64_t> chunks = shape;
+    chunks[axis] = chunk;
+
+    json::Object zarray;
+    zarray.add("zarr_format", 2);
+    zarray.add("shape", shape);
+    zarray.add("chunks", chunks);
+    zarray.add("dtype", dtype<T>());
+    zarray.add("order", "C");
+    if (level > 0) {
+      json::Object compressor;
+      compressor.add("id", "gzip");
+      compressor.add("level", level);
+      zarray.add("compressor", compressor);
+    } else {
+      zarray.add_null("compressor");
+    }
+    zarray.add_null("filters");
+    if (std::is_floating_point<T>::value) {
+      zarray.add("fill_value", "NaN");
+    } else {
+      zarray.add_null("fill_value");
+    }
+    write_metadata(path(array_name, ".zarray"), zarray);
+
+    json::Object zattrs;
+    zattrs.add("_ARRAY_DIMENSIONS", dimensions);
+    write_metadata(path(array_name, ".zattrs"), zattrs);
+  }
+
+  template <typename T>
+  static T fill() {
+    return std::is_floating_point<T>::value
+               ? std::numeric_limits<T>::quiet_NaN()
+               : 0;
+  }
+
+  static std::string path(const std::string& name, const std::string& file) {
+    return name.empty() ? file : name + "/" + file;
+  }
+
+  void write_metadata(const std::string& name, json::Object& object) {
+    consolidated.copy(name, object);
+    object.write(dir / name);
+  }
+
+  const std::filesystem::path dir;
+  const int chunk_size;
+  const int level;
+  json::Object attrs;
+  json::Object consolidated;
+  async::Files out;
+};
+
+}  // end namespace zarr
+}  // end namespace polystan
+
+#endif  // POLYSTAN_ZARR_HPP_